@@ -0,0 +1,433 @@
+/**
+ * @section DESCRIPTION
+ *
+ * Micro-benchmarks for the watch's hot paths, built for the host against the
+ * stub in pebble.h: number formatting, applying a new app table, and the
+ * whole App Message receive path, fed with synthetic message streams. Each
+ * benchmark reports time per operation, plus what an operation costs in
+ * stub terms: allocations, layer_mark_dirty calls, and update procs run (and
+ * text drawn) when the screen is rendered after it.
+ *
+ * Before any timing, the number formats are checked against a printf-based
+ * reference: over every value up to CHECK_RANGE, every 16 bit value where
+ * the input is 16 bits on the watch, and every value next to a rounding or
+ * unit boundary across the whole uint32 range. Any mismatch fails the run.
+ *
+ * Run with `waf configure bench` (see wscript). Timings are only
+ * comparable between runs on the same machine.
+ */
+
+// For clock_gettime:
+#define _POSIX_C_SOURCE 199309L
+
+// Included rather than linked, so the benchmarks can reach its statics:
+#include "newrelic_layer.c"
+#include "clock_layer.h"
+#include "number_format.h"
+#include "pebble_host.h"
+
+
+/** Operations per benchmark. */
+#define BENCH_ITERATIONS 200000
+
+/** Every value below this is checked, for every number format. */
+#define CHECK_RANGE 2000000
+
+/** Largest synthetic message; the same bound the phone works with. */
+#define BENCH_MESSAGE_MAX_SIZE TRANSFER_MAX_SIZE
+
+/** A benchmarked operation. */
+typedef void (*BenchOp)(uint32_t i);
+
+/** A serialized App Message and an iterator over it. */
+typedef struct {
+  uint8_t buffer[BENCH_MESSAGE_MAX_SIZE];
+  uint16_t size;
+  DictionaryIterator iter;
+} BenchMessage;
+
+/** Written by the benchmarks so the compiler can't drop their work. */
+static volatile uint32_t sink;
+
+/** Inputs for the number formatting benchmark, across every unit. */
+static const unsigned int numbers[] = {
+  0, 7, 42, 999, 1000, 1850, 99999, 123456, 1850000, 27000000, 999999999,
+  1000000000, 4294967295u,
+};
+
+/** Packed app tables: two versions of each, differing in every app. */
+static uint8_t table_1app[2][NEWRELIC_TABLE_MAX_SIZE];
+static size_t table_1app_size[2];
+static uint8_t table_12apps[2][NEWRELIC_TABLE_MAX_SIZE];
+static size_t table_12apps_size[2];
+
+/** The same two 12 app tables, as messages from the phone. */
+static BenchMessage messages[2];
+
+/** Every minute of a day, for the clock benchmark. */
+#define MINUTES_PER_DAY (24 * 60)
+static struct tm day_minutes[MINUTES_PER_DAY];
+
+/** The first of those messages split into transfer chunks. */
+static BenchMessage chunks[TRANSFER_MAX_CHUNKS];
+static uint8_t chunk_count;
+
+/**
+ * Returns a monotonic timestamp.
+ *
+ * @return Nanoseconds from an arbitrary starting point.
+ */
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Builds a packed app table of made-up apps.
+ *
+ * @param count Number of apps.
+ * @param variant Varies every metric, so tables with different variants
+ *        differ in every app.
+ * @param data Output buffer of at least NEWRELIC_TABLE_MAX_SIZE bytes.
+ * @return Size of the table in bytes.
+ */
+static size_t make_table(uint8_t count, uint32_t variant, uint8_t *data) {
+  NewrelicAppRecord apps[NEWRELIC_MAX_APPS];
+  memset(apps, 0, sizeof(apps));
+  for (uint8_t i = 0; i < count; i++) {
+    snprintf(apps[i].name, sizeof(apps[i].name), "Production App %d", i);
+    apps[i].metrics = (NewrelicMetrics) {
+      .apdex_x100 = 90 + variant,
+      .error_rate_x100 = 12 * i + variant,
+      .response_time_us = 180000 + 1000 * i + variant,
+      .throughput = 1850000 + i + variant,
+    };
+  }
+  return newrelic_table_encode(apps, count, data);
+}
+
+/**
+ * Serializes a table update the way the phone sends it: the table plus its
+ * data age.
+ *
+ * @param message Output message.
+ * @param table The packed table.
+ * @param table_size Size of the table in bytes.
+ */
+static void make_table_message(BenchMessage *message, const uint8_t *table,
+    size_t table_size) {
+  DictionaryIterator iter;
+  dict_write_begin(&iter, message->buffer, sizeof(message->buffer));
+  dict_write_data(&iter, APP_TABLE_KEY, table, table_size);
+  dict_write_int32(&iter, DATA_AGE_KEY, 0);
+  message->size = dict_write_end(&iter);
+  dict_read_begin_from_buffer(&message->iter, message->buffer, message->size);
+}
+
+/**
+ * Splits a message into transfer chunks, as TransferSender in the phone JS
+ * does. The transfer ID is left 0; the benchmark fills it in.
+ *
+ * @param message The message to split.
+ */
+static void make_chunks(const BenchMessage *message) {
+  chunk_count = (message->size + TRANSFER_CHUNK_SIZE - 1) /
+      TRANSFER_CHUNK_SIZE;
+  for (uint8_t seq = 0; seq < chunk_count; seq++) {
+    uint8_t chunk[TRANSFER_HEADER_SIZE + TRANSFER_CHUNK_SIZE] = {
+      0, seq, chunk_count,
+    };
+    uint16_t offset = seq * TRANSFER_CHUNK_SIZE;
+    uint16_t length = message->size - offset < TRANSFER_CHUNK_SIZE ?
+        message->size - offset : TRANSFER_CHUNK_SIZE;
+    memcpy(chunk + TRANSFER_HEADER_SIZE, message->buffer + offset, length);
+
+    DictionaryIterator iter;
+    dict_write_begin(&iter, chunks[seq].buffer, sizeof(chunks[seq].buffer));
+    dict_write_data(&iter, XFER_CHUNK_KEY, chunk,
+        TRANSFER_HEADER_SIZE + length);
+    chunks[seq].size = dict_write_end(&iter);
+    dict_read_begin_from_buffer(&chunks[seq].iter, chunks[seq].buffer,
+        chunks[seq].size);
+  }
+}
+
+/** Formats one number for display, as a count and as a duration. */
+static void op_format_number(uint32_t i) {
+  char result[FORMAT_BUFFER_SIZE];
+  uint32_t number = numbers[i % (sizeof(numbers) / sizeof(numbers[0]))];
+  sink += format_count(result, number);
+  sink += format_duration_us(result, number);
+}
+
+/** Applies the same single app table over and over, like most polls. */
+static void op_display_unchanged_1app(uint32_t i) {
+  display_newrelic_data(table_1app[0], table_1app_size[0], 0);
+}
+
+/** Applies a table whose metrics differ from the one on screen. */
+static void op_display_changed_12apps(uint32_t i) {
+  display_newrelic_data(table_12apps[i % 2], table_12apps_size[i % 2], 0);
+}
+
+/** Receives the same 12 app table message over and over. */
+static void op_receive_unchanged_12apps(uint32_t i) {
+  newrelic_app_msg_in_received_handler(&messages[0].iter, NULL);
+}
+
+/** Receives 12 app table messages that differ every time. */
+static void op_receive_changed_12apps(uint32_t i) {
+  newrelic_app_msg_in_received_handler(&messages[i % 2].iter, NULL);
+}
+
+/** Receives an unchanged message a minute after the last one. */
+static void op_receive_next_minute_12apps(uint32_t i) {
+  host_advance_ms(60 * 1000);
+  newrelic_app_msg_in_received_handler(&messages[0].iter, NULL);
+}
+
+/** Receives a whole chunked transfer, the way main.c dispatches it. */
+static void op_receive_chunked_12apps(uint32_t i) {
+  // A new transfer ID every time, so none look like resends:
+  uint8_t id = i % 256;
+  for (uint8_t seq = 0; seq < chunk_count; seq++) {
+    uint8_t *chunk = dict_read_first(&chunks[seq].iter)->value->data;
+    chunk[0] = id;
+    DictionaryIterator *message = transfer_receive(&chunks[seq].iter);
+    if (message) newrelic_app_msg_in_received_handler(message, NULL);
+  }
+}
+
+/** Ticks the clock over to the next minute, round the clock. */
+static void op_minute_tick(uint32_t i) {
+  clock_layer_handle_minute_tick(&day_minutes[i % MINUTES_PER_DAY], 
+      MINUTE_UNIT);
+}
+
+/** A compact number format, and its units as the reference knows them. */
+typedef struct {
+  const char *name;
+  size_t (*format)(char *buffer, uint32_t value);
+  uint8_t unit_count;
+  uint8_t exponents[4];
+  const char *suffixes[4];
+} CheckedFormat;
+
+static const CheckedFormat checked_formats[] = {
+  { "format_count", format_count, 4, { 0, 3, 6, 9 }, { "", "k", "m", "b" } },
+  { "format_duration_us", format_duration_us, 2, { 3, 6 }, { "ms", "s" } },
+  { "format_percent_x100", format_percent_x100, 1, { 2 }, { "%" } },
+};
+
+/**
+ * Returns 10 to the given power.
+ */
+static uint64_t power_of_ten(uint8_t exponent) {
+  uint64_t power = 1;
+  while (exponent--) power *= 10;
+  return power;
+}
+
+/**
+ * The reference for the compact formats: tries every unit, smallest first,
+ * and every number of decimals, most first, and takes the first that's
+ * within FORMAT_SIGNIFICANT_DIGITS digits once rounded. Only the largest
+ * unit may take more, when nothing else fits.
+ *
+ * @param format The format to produce.
+ * @param value The number, in the format's base unit.
+ * @param expected Output buffer of at least FORMAT_BUFFER_SIZE bytes.
+ */
+static void reference_compact(const CheckedFormat *format, uint32_t value,
+    char *expected) {
+  const uint64_t limit = power_of_ten(FORMAT_SIGNIFICANT_DIGITS);
+  for (uint8_t unit = 0; unit < format->unit_count; unit++) {
+    bool last = unit + 1 == format->unit_count;
+    uint64_t unit_size = power_of_ten(format->exponents[unit]);
+    int decimals = format->exponents[unit];
+    if (decimals > FORMAT_SIGNIFICANT_DIGITS - 1) {
+      decimals = FORMAT_SIGNIFICANT_DIGITS - 1;
+    }
+    for (; decimals >= 0; decimals--) {
+      uint64_t scale = power_of_ten(decimals);
+      uint64_t rounded = (2 * (uint64_t) value * scale + unit_size) /
+          (2 * unit_size);
+      if (rounded >= limit && !(last && decimals == 0)) continue;
+      if (decimals == 0) {
+        snprintf(expected, FORMAT_BUFFER_SIZE, "%llu%s",
+            (unsigned long long) rounded, format->suffixes[unit]);
+      } else {
+        snprintf(expected, FORMAT_BUFFER_SIZE, "%llu.%0*llu%s",
+            (unsigned long long) (rounded / scale), decimals,
+            (unsigned long long) (rounded % scale), format->suffixes[unit]);
+      }
+      return;
+    }
+  }
+}
+
+/**
+ * Checks every number format for one value.
+ *
+ * @param value The value to check.
+ * @param all_formats False to skip the formats whose input is 16 bits on the 
+ *        watch, for values beyond that.
+ * @return True if every format matched the reference.
+ */
+static bool check_value(uint32_t value, bool all_formats) {
+  char result[FORMAT_BUFFER_SIZE];
+  char expected[FORMAT_BUFFER_SIZE];
+  for (size_t i = 0; i < sizeof(checked_formats) / sizeof(checked_formats[0]);
+      i++) {
+    const CheckedFormat *format = &checked_formats[i];
+    if (!all_formats && format->format == format_percent_x100) continue;
+    size_t length = format->format(result, value);
+    reference_compact(format, value, expected);
+    if (strcmp(result, expected) != 0 || length != strlen(result) ||
+        length > FORMAT_COMPACT_MAX_LENGTH) {
+      printf("%s(%u): got \"%s\" (%d), expected \"%s\"\n", format->name,
+          (unsigned int) value, result, (int) length, expected);
+      return false;
+    }
+  }
+
+  size_t length = format_uint(result, value);
+  snprintf(expected, sizeof(expected), "%u", (unsigned int) value);
+  if (strcmp(result, expected) != 0 || length != strlen(result)) {
+    printf("format_uint(%u): got \"%s\", expected \"%s\"\n",
+        (unsigned int) value, result, expected);
+    return false;
+  }
+  if (all_formats) {
+    length = format_fixed(result, value, 2, "ap");
+    snprintf(expected, sizeof(expected), "%u.%02uap",
+        (unsigned int) value / 100, (unsigned int) value % 100);
+    if (strcmp(result, expected) != 0 || length != strlen(result)) {
+      printf("format_fixed(%u, 2): got \"%s\", expected \"%s\"\n",
+          (unsigned int) value, result, expected);
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * Checks the number formats against the reference, as described above.
+ *
+ * @return Number of values checked, or 0 on a mismatch.
+ */
+static uint32_t check_number_formats(void) {
+  uint32_t checked = 0;
+  for (uint32_t value = 0; value < CHECK_RANGE; value++, checked++) {
+    if (!check_value(value, value <= UINT16_MAX)) return 0;
+  }
+  // Either side of every point where rounding goes up a digit, and of every
+  // power of ten:
+  for (uint8_t exponent = 1; exponent <= 9; exponent++) {
+    uint64_t step = power_of_ten(exponent);
+    for (uint64_t n = 0; n < 10000; n++) {
+      uint64_t edges[] = { n * step + step / 2, n * step };
+      for (int e = 0; e < 2; e++) {
+        for (int64_t value = edges[e] - 1; value <= (int64_t) edges[e] + 1;
+            value++) {
+          if (value < CHECK_RANGE || value > UINT32_MAX) continue;
+          if (!check_value(value, false)) return 0;
+          checked++;
+        }
+      }
+    }
+  }
+  return check_value(UINT32_MAX, false) ? checked + 1 : 0;
+}
+
+/**
+ * Runs a benchmark and prints its results. The operation is run twice over:
+ * once timed, and once rendering the screen after each run to count the
+ * redraws it causes.
+ *
+ * @param name Name to report the results under.
+ * @param op The operation to benchmark.
+ */
+static void run_bench(const char *name, BenchOp op) {
+  // Start each benchmark from a settled screen:
+  host_render();
+
+  host_reset_stats();
+  uint64_t start = now_ns();
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) op(i);
+  uint64_t elapsed = now_ns() - start;
+  HostStats timed = host_stats;
+
+  host_reset_stats();
+  for (uint32_t i = 0; i < BENCH_ITERATIONS; i++) {
+    op(i);
+    host_render();
+  }
+
+  const double n = BENCH_ITERATIONS;
+  printf("%-28s %9.1f %9.3f %9.3f %9.3f %9.3f\n", name, elapsed / n,
+      timed.allocs / n, timed.dirty_marks / n, host_stats.redraws / n,
+      host_stats.text_draws / n);
+}
+
+int main(void) {
+  host_set_log_output(false);
+
+  uint32_t checked = check_number_formats();
+  if (!checked) return 1;
+  printf("Number formats match the reference for %u values\n\n",
+      (unsigned int) checked);
+
+  for (uint32_t variant = 0; variant < 2; variant++) {
+    table_1app_size[variant] = make_table(1, variant, table_1app[variant]);
+    table_12apps_size[variant] = make_table(NEWRELIC_MAX_APPS, variant,
+        table_12apps[variant]);
+    make_table_message(&messages[variant], table_12apps[variant],
+        table_12apps_size[variant]);
+  }
+  make_chunks(&messages[0]);
+  for (int minute = 0; minute < MINUTES_PER_DAY; minute++) {
+    time_t t = 14 * 24 * 60 * 60 + minute * 60;
+    day_minutes[minute] = *gmtime(&t);
+  }
+
+  Layer *root = layer_create(GRect(0, 0, HOST_SCREEN_WIDTH,
+      HOST_SCREEN_HEIGHT));
+  Layer *clock_parent = layer_create(GRect(0, 0, HOST_SCREEN_WIDTH, 84));
+  layer_add_child(root, clock_parent);
+  clock_layer_init(clock_parent);
+  Layer *parent = layer_create(GRect(0, 84, HOST_SCREEN_WIDTH, 84));
+  layer_add_child(root, parent);
+  app_message_register_outbox_sent(outbox_queue_handle_sent);
+  app_message_register_outbox_failed(outbox_queue_handle_failed);
+  app_message_open(NEWRELIC_INBOX_SIZE, NEWRELIC_OUTBOX_SIZE);
+  newrelic_layer_init(parent);
+  host_finish_outbox(APP_MSG_OK);  // the phone got the initial update request
+  printf("Heap in use after init: %d bytes\n\n", (int) heap_bytes_used());
+
+  printf("%-28s %9s %9s %9s %9s %9s\n", "benchmark", "ns/op", "allocs/op",
+      "dirty/op", "redraw/op", "text/op");
+  run_bench("format/count+duration", op_format_number);
+  run_bench("display/unchanged/1app", op_display_unchanged_1app);
+  run_bench("display/changed/12apps", op_display_changed_12apps);
+  run_bench("receive/unchanged/12apps", op_receive_unchanged_12apps);
+  run_bench("receive/changed/12apps", op_receive_changed_12apps);
+  run_bench("receive/next-minute/12apps", op_receive_next_minute_12apps);
+  run_bench("receive/chunked/12apps", op_receive_chunked_12apps);
+  // Covered by a notification, changes are held back until it's dismissed:
+  newrelic_layer_handle_focus(false);
+  run_bench("receive/obscured/12apps", op_receive_changed_12apps);
+  newrelic_layer_handle_focus(true);
+  host_finish_outbox(APP_MSG_OK);  // the phone got the catch-up request
+  run_bench("clock/minute-tick", op_minute_tick);
+
+  newrelic_layer_deinit();
+  layer_destroy(parent);
+  clock_layer_deinit();
+  layer_destroy(clock_parent);
+  layer_destroy(root);
+  outbox_queue_deinit();
+  printf("\nHeap in use after deinit: %d bytes\n", (int) heap_bytes_used());
+  return 0;
+}
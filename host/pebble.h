@@ -0,0 +1,399 @@
+/**
+ * @section DESCRIPTION
+ *
+ * A host (desktop) stand-in for the parts of the Pebble SDK 2 API that the
+ * watch app uses, so the real sources in src/ can be compiled and exercised
+ * on a plain Linux box without the SDK or an emulator. Types and signatures
+ * follow the SDK's pebble.h; the behaviour is implemented in pebble_host.c,
+ * which counts calls and allocations instead of drawing anything. The test
+ * harness side of the stub (counters, clock control) is in pebble_host.h.
+ *
+ * Only what src/ actually needs is declared here. Add to it as the app
+ * starts using more of the SDK.
+ */
+
+#ifndef __HOST_PEBBLE_H__
+#define __HOST_PEBBLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+
+/* Resources. Mirrors the "media" list in appinfo.json. */
+
+enum {
+  RESOURCE_ID_IMAGE_NEWRELIC_MENU_ICON = 1,
+  RESOURCE_ID_IMAGE_CLOCK_DIGITS,
+  RESOURCE_ID_FONT_SIGNIKA_REGULAR_16,
+  RESOURCE_ID_FONT_SIGNIKA_REGULAR_12,
+};
+
+typedef struct ResHandle_ *ResHandle;
+
+ResHandle resource_get_handle(uint32_t resource_id);
+
+
+/* Logging */
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+  APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number,
+    const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
+#define APP_LOG(level, fmt, args...) \
+  app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+
+/* Time. time() reads the host's fake clock (see host_set_time). */
+
+#define time(timer) host_time(timer)
+time_t host_time(time_t *timer);
+
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms);
+
+bool clock_is_24h_style(void);
+
+
+/* Graphics types */
+
+typedef struct {
+  int16_t x;
+  int16_t y;
+} GPoint;
+
+typedef struct {
+  int16_t w;
+  int16_t h;
+} GSize;
+
+typedef struct {
+  GPoint origin;
+  GSize size;
+} GRect;
+
+#define GPoint(x, y) ((GPoint) { (x), (y) })
+#define GSize(w, h) ((GSize) { (w), (h) })
+#define GRect(x, y, w, h) ((GRect) { { (x), (y) }, { (w), (h) } })
+
+typedef enum {
+  GColorClear = -1,
+  GColorBlack = 0,
+  GColorWhite = 1,
+} GColor;
+
+typedef enum {
+  GCornerNone = 0,
+} GCornerMask;
+
+typedef enum {
+  GTextAlignmentLeft,
+  GTextAlignmentCenter,
+  GTextAlignmentRight,
+} GTextAlignment;
+
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef enum {
+  GCompOpAssign,
+  GCompOpAssignInverted,
+  GCompOpOr,
+  GCompOpAnd,
+  GCompOpClear,
+  GCompOpSet,
+} GCompOp;
+
+typedef struct GFontInfo *GFont;
+typedef struct GTextLayoutCache *GTextLayoutCacheRef;
+typedef struct GContext GContext;
+
+/** Public in SDK 2, and the sparkline draws into it directly. */
+typedef struct {
+  void *addr;
+  uint16_t row_size_bytes;
+  uint16_t info_flags;
+  GRect bounds;
+} GBitmap;
+
+GFont fonts_load_custom_font(ResHandle handle);
+void fonts_unload_custom_font(GFont font);
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+GBitmap *gbitmap_create_blank(GSize size);
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap,
+    GRect sub_rect);
+void gbitmap_destroy(GBitmap *bitmap);
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+    GCornerMask corner_mask);
+void graphics_draw_text(GContext *ctx, const char *text, GFont font,
+    GRect box, GTextOverflowMode overflow_mode, GTextAlignment alignment,
+    GTextLayoutCacheRef layout);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap,
+    GRect rect);
+
+
+/* Layers and windows */
+
+typedef struct Layer Layer;
+typedef struct TextLayer TextLayer;
+typedef struct Window Window;
+
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+GRect layer_get_bounds(const Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_mark_dirty(Layer *layer);
+void layer_set_hidden(Layer *layer, bool hidden);
+bool layer_get_hidden(const Layer *layer);
+
+TextLayer *text_layer_create(GRect frame);
+void text_layer_destroy(TextLayer *text_layer);
+Layer *text_layer_get_layer(TextLayer *text_layer);
+void text_layer_set_text(TextLayer *text_layer, const char *text);
+void text_layer_set_text_color(TextLayer *text_layer, GColor color);
+void text_layer_set_background_color(TextLayer *text_layer, GColor color);
+void text_layer_set_font(TextLayer *text_layer, GFont font);
+void text_layer_set_text_alignment(TextLayer *text_layer,
+    GTextAlignment alignment);
+
+typedef void (*WindowHandler)(Window *window);
+
+typedef struct {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+Window *window_create(void);
+void window_destroy(Window *window);
+Layer *window_get_root_layer(const Window *window);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+void window_set_background_color(Window *window, GColor color);
+void window_stack_push(Window *window, bool animated);
+
+void app_event_loop(void);
+
+
+/* Timers and event services */
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+    void *callback_data);
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer);
+
+typedef enum {
+  SECOND_UNIT = 1 << 0,
+  MINUTE_UNIT = 1 << 1,
+  HOUR_UNIT = 1 << 2,
+  DAY_UNIT = 1 << 3,
+  MONTH_UNIT = 1 << 4,
+  YEAR_UNIT = 1 << 5,
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+typedef void (*BluetoothConnectionHandler)(bool connected);
+
+void bluetooth_connection_service_subscribe(
+    BluetoothConnectionHandler handler);
+void bluetooth_connection_service_unsubscribe(void);
+bool bluetooth_connection_service_peek(void);
+
+typedef void (*AppFocusHandler)(bool in_focus);
+
+void app_focus_service_subscribe(AppFocusHandler handler);
+void app_focus_service_unsubscribe(void);
+
+typedef enum {
+  ACCEL_AXIS_X = 0,
+  ACCEL_AXIS_Y = 1,
+  ACCEL_AXIS_Z = 2,
+} AccelAxisType;
+
+typedef void (*AccelTapHandler)(AccelAxisType axis, int32_t direction);
+
+void accel_tap_service_subscribe(AccelTapHandler handler);
+void accel_tap_service_unsubscribe(void);
+
+
+/* Dictionaries, serialized the same way as on the watch */
+
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3,
+} TupleType;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  union {
+    uint8_t data[0];
+    char cstring[0];
+    uint8_t uint8;
+    uint16_t uint16;
+    uint32_t uint32;
+    int8_t int8;
+    int16_t int16;
+    int32_t int32;
+  } value[];
+} Tuple;
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t count;
+  Tuple head[];
+} Dictionary;
+
+typedef struct {
+  Dictionary *dictionary;
+  const void *end;
+  Tuple *cursor;
+} DictionaryIterator;
+
+typedef struct {
+  TupleType type;
+  uint32_t key;
+  union {
+    struct {
+      const uint8_t *data;
+      uint16_t length;
+    } bytes;
+    struct {
+      const char *data;
+      uint16_t length;
+    } cstring;
+    struct {
+      uint32_t storage;
+      uint16_t width;
+    } integer;
+  };
+} Tuplet;
+
+#define TupletInteger(_key, _integer) ((const Tuplet) { \
+    .type = TUPLE_INT, .key = _key, \
+    .integer = { .storage = _integer, .width = sizeof(_integer) } })
+
+#define TupletBytes(_key, _data, _length) ((const Tuplet) { \
+    .type = TUPLE_BYTE_ARRAY, .key = _key, \
+    .bytes = { .data = _data, .length = _length } })
+
+typedef enum {
+  DICT_OK = 0,
+  DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+  DICT_INVALID_ARGS = 1 << 2,
+} DictionaryResult;
+
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *buffer,
+    const uint16_t size);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+    const uint8_t * const data, const uint16_t size);
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key,
+    const void *integer, const uint8_t width_bytes, const bool is_signed);
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key,
+    const int32_t value);
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter,
+    const Tuplet * const tuplet);
+uint32_t dict_write_end(DictionaryIterator *iter);
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...);
+
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter,
+    const uint8_t * const buffer, const uint16_t size);
+Tuple *dict_read_first(DictionaryIterator *iter);
+Tuple *dict_read_next(DictionaryIterator *iter);
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key);
+
+
+/* App Message */
+
+typedef enum {
+  APP_MSG_OK = 0,
+  APP_MSG_SEND_TIMEOUT = 1 << 1,
+  APP_MSG_SEND_REJECTED = 1 << 2,
+  APP_MSG_NOT_CONNECTED = 1 << 3,
+  APP_MSG_APP_NOT_RUNNING = 1 << 4,
+  APP_MSG_INVALID_ARGS = 1 << 5,
+  APP_MSG_BUSY = 1 << 6,
+  APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+  APP_MSG_ALREADY_RELEASED = 1 << 9,
+  APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+  APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+  APP_MSG_OUT_OF_MEMORY = 1 << 12,
+  APP_MSG_CLOSED = 1 << 13,
+  APP_MSG_INTERNAL_ERROR = 1 << 14,
+} AppMessageResult;
+
+typedef void (*AppMessageInboxReceived)(DictionaryIterator *iterator,
+    void *context);
+typedef void (*AppMessageInboxDropped)(AppMessageResult reason,
+    void *context);
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator,
+    void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator,
+    AppMessageResult reason, void *context);
+
+AppMessageResult app_message_open(const uint32_t size_inbound,
+    const uint32_t size_outbound);
+AppMessageInboxReceived app_message_register_inbox_received(
+    AppMessageInboxReceived received_callback);
+AppMessageInboxDropped app_message_register_inbox_dropped(
+    AppMessageInboxDropped dropped_callback);
+AppMessageOutboxSent app_message_register_outbox_sent(
+    AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(
+    AppMessageOutboxFailed failed_callback);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+
+/* Persistent storage, kept in memory for the life of the process */
+
+#define PERSIST_DATA_MAX_LENGTH 256
+
+typedef int32_t status_t;
+
+#define S_SUCCESS 0
+#define E_DOES_NOT_EXIST (-10)
+#define E_OUT_OF_STORAGE (-12)
+
+bool persist_exists(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+status_t persist_delete(const uint32_t key);
+
+
+/* Heap. Counts what the stub allocates on the app's behalf. */
+
+size_t heap_bytes_used(void);
+size_t heap_bytes_free(void);
+
+
+#endif  // __HOST_PEBBLE_H__
@@ -0,0 +1,854 @@
+#include <stdarg.h>
+#include <pebble.h>
+#include "pebble_host.h"
+
+
+HostStats host_stats;
+
+static bool log_output = true;
+
+/** The fake clock: wall time at start, plus milliseconds elapsed since. */
+static time_t clock_base = 1400000000;
+static uint64_t clock_ms;
+
+
+/* Heap accounting. Every stub object goes through these, prefixed with its
+ * size so heap_bytes_used can track frees too. */
+
+typedef union {
+  size_t size;
+  long double align;  // keeps what follows the header aligned
+} HostAllocHeader;
+
+static size_t heap_used;
+
+/**
+ * Allocates zeroed memory on the app's behalf and counts it.
+ *
+ * @param size Bytes needed.
+ * @return The memory. Aborts if the host is out of memory.
+ */
+static void *host_alloc(size_t size) {
+  HostAllocHeader *header = calloc(1, sizeof(HostAllocHeader) + size);
+  if (!header) abort();
+  header->size = size;
+  heap_used += size;
+  host_stats.allocs++;
+  return header + 1;
+}
+
+/**
+ * Frees memory from host_alloc. NULL is ignored.
+ *
+ * @param ptr The memory to free.
+ */
+static void host_free(void *ptr) {
+  if (!ptr) return;
+  HostAllocHeader *header = (HostAllocHeader *) ptr - 1;
+  heap_used -= header->size;
+  host_stats.frees++;
+  free(header);
+}
+
+// Docs are in the Pebble SDK.
+size_t heap_bytes_used(void) {
+  return heap_used;
+}
+
+// Docs are in the Pebble SDK.
+size_t heap_bytes_free(void) {
+  return heap_used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - heap_used : 0;
+}
+
+
+/* Logging and time */
+
+// Docs are in the Pebble SDK.
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number,
+    const char *fmt, ...) {
+  host_stats.logs++;
+  if (!log_output) return;
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%d] %s:%d ", log_level, src_filename, src_line_number);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+// Docs are in pebble.h.
+time_t host_time(time_t *timer) {
+  time_t now = clock_base + (time_t) (clock_ms / 1000);
+  if (timer) *timer = now;
+  return now;
+}
+
+// Docs are in the Pebble SDK.
+uint16_t time_ms(time_t *t_utc, uint16_t *out_ms) {
+  uint16_t ms = clock_ms % 1000;
+  host_time(t_utc);
+  if (out_ms) *out_ms = ms;
+  return ms;
+}
+
+// Docs are in the Pebble SDK.
+bool clock_is_24h_style(void) {
+  return true;
+}
+
+// Docs are in pebble_host.h.
+void host_reset_stats(void) {
+  memset(&host_stats, 0, sizeof(host_stats));
+}
+
+// Docs are in pebble_host.h.
+void host_set_log_output(bool enabled) {
+  log_output = enabled;
+}
+
+// Docs are in pebble_host.h.
+void host_set_time(time_t now) {
+  clock_base = now - (time_t) (clock_ms / 1000);
+}
+
+
+/* Resources and graphics. Nothing is actually drawn. */
+
+struct GFontInfo {
+  uint32_t resource_id;
+};
+
+struct GContext {
+  GColor fill_color;
+  GColor text_color;
+};
+
+static GContext screen_context;
+
+// Docs are in the Pebble SDK.
+ResHandle resource_get_handle(uint32_t resource_id) {
+  return (ResHandle) (uintptr_t) resource_id;
+}
+
+// Docs are in the Pebble SDK.
+GFont fonts_load_custom_font(ResHandle handle) {
+  GFont font = host_alloc(sizeof(*font));
+  font->resource_id = (uint32_t) (uintptr_t) handle;
+  return font;
+}
+
+// Docs are in the Pebble SDK.
+void fonts_unload_custom_font(GFont font) {
+  host_free(font);
+}
+
+/** GBitmap info_flags bit for bitmaps that own their pixel data. */
+#define BITMAP_OWNS_DATA 1
+
+// Docs are in the Pebble SDK.
+GBitmap *gbitmap_create_blank(GSize size) {
+  GBitmap *bitmap = host_alloc(sizeof(*bitmap));
+  // Rows are padded to whole 32-bit words, like on the watch:
+  bitmap->row_size_bytes = (size.w + 31) / 32 * 4;
+  bitmap->info_flags = BITMAP_OWNS_DATA;
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->addr = host_alloc(bitmap->row_size_bytes * size.h);
+  return bitmap;
+}
+
+// Docs are in the Pebble SDK. Image resources aren't read; they come back as
+// blank, screen-sized bitmaps.
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id) {
+  return gbitmap_create_blank(GSize(HOST_SCREEN_WIDTH, HOST_SCREEN_HEIGHT));
+}
+
+// Docs are in the Pebble SDK.
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap,
+    GRect sub_rect) {
+  GBitmap *bitmap = host_alloc(sizeof(*bitmap));
+  *bitmap = *base_bitmap;
+  bitmap->info_flags &= ~BITMAP_OWNS_DATA;
+  bitmap->bounds = sub_rect;
+  return bitmap;
+}
+
+// Docs are in the Pebble SDK.
+void gbitmap_destroy(GBitmap *bitmap) {
+  if (!bitmap) return;
+  if (bitmap->info_flags & BITMAP_OWNS_DATA) host_free(bitmap->addr);
+  host_free(bitmap);
+}
+
+// Docs are in the Pebble SDK.
+void graphics_context_set_fill_color(GContext *ctx, GColor color) {
+  ctx->fill_color = color;
+}
+
+// Docs are in the Pebble SDK.
+void graphics_context_set_text_color(GContext *ctx, GColor color) {
+  ctx->text_color = color;
+}
+
+// Docs are in the Pebble SDK.
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius,
+    GCornerMask corner_mask) {
+}
+
+// Docs are in the Pebble SDK.
+void graphics_draw_text(GContext *ctx, const char *text, GFont font,
+    GRect box, GTextOverflowMode overflow_mode, GTextAlignment alignment,
+    GTextLayoutCacheRef layout) {
+  host_stats.text_draws++;
+}
+
+// Docs are in the Pebble SDK.
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap,
+    GRect rect) {
+}
+
+
+/* Layers. Every live layer is kept in one list so host_render can find the
+ * dirty ones without walking the tree. */
+
+struct Layer {
+  GRect frame;
+  LayerUpdateProc update_proc;
+  Layer *parent;
+  bool hidden;
+  bool dirty;
+  Layer *next_live;  // next in live_layers
+};
+
+struct TextLayer {
+  Layer layer;
+  const char *text;
+  GFont font;
+};
+
+struct Window {
+  Layer root;
+  WindowHandlers handlers;
+};
+
+static Layer *live_layers;
+
+/**
+ * Sets up a layer and adds it to the live list.
+ *
+ * @param layer The layer to set up.
+ * @param frame Its frame.
+ */
+static void layer_setup(Layer *layer, GRect frame) {
+  layer->frame = frame;
+  layer->dirty = true;
+  layer->next_live = live_layers;
+  live_layers = layer;
+}
+
+/**
+ * Removes a layer from the live list.
+ *
+ * @param layer The layer to remove.
+ */
+static void layer_teardown(Layer *layer) {
+  for (Layer **link = &live_layers; *link; link = &(*link)->next_live) {
+    if (*link == layer) {
+      *link = layer->next_live;
+      return;
+    }
+  }
+}
+
+/**
+ * Reports whether a layer would be drawn: neither it nor any of its
+ * ancestors is hidden.
+ *
+ * @param layer The layer to check.
+ * @return True if visible.
+ */
+static bool layer_is_visible(const Layer *layer) {
+  for (; layer; layer = layer->parent) {
+    if (layer->hidden) return false;
+  }
+  return true;
+}
+
+// Docs are in the Pebble SDK.
+Layer *layer_create(GRect frame) {
+  Layer *layer = host_alloc(sizeof(*layer));
+  layer_setup(layer, frame);
+  return layer;
+}
+
+// Docs are in the Pebble SDK.
+void layer_destroy(Layer *layer) {
+  if (!layer) return;
+  layer_teardown(layer);
+  host_free(layer);
+}
+
+// Docs are in the Pebble SDK.
+void layer_add_child(Layer *parent, Layer *child) {
+  child->parent = parent;
+}
+
+// Docs are in the Pebble SDK.
+GRect layer_get_bounds(const Layer *layer) {
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+// Docs are in the Pebble SDK.
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc) {
+  layer->update_proc = update_proc;
+}
+
+// Docs are in the Pebble SDK.
+void layer_mark_dirty(Layer *layer) {
+  host_stats.dirty_marks++;
+  layer->dirty = true;
+}
+
+// Docs are in the Pebble SDK.
+void layer_set_hidden(Layer *layer, bool hidden) {
+  if (layer->hidden == hidden) return;
+  layer->hidden = hidden;
+  // The OS redraws whatever was under the layer:
+  if (layer->parent) layer->parent->dirty = true;
+}
+
+// Docs are in the Pebble SDK.
+bool layer_get_hidden(const Layer *layer) {
+  return layer->hidden;
+}
+
+// Docs are in pebble_host.h.
+void host_render(void) {
+  for (Layer *layer = live_layers; layer; layer = layer->next_live) {
+    if (!layer->dirty) continue;
+    layer->dirty = false;
+    if (!layer->update_proc || !layer_is_visible(layer)) continue;
+    host_stats.redraws++;
+    layer->update_proc(layer, &screen_context);
+  }
+}
+
+// Docs are in the Pebble SDK.
+TextLayer *text_layer_create(GRect frame) {
+  TextLayer *text_layer = host_alloc(sizeof(*text_layer));
+  layer_setup(&text_layer->layer, frame);
+  return text_layer;
+}
+
+// Docs are in the Pebble SDK.
+void text_layer_destroy(TextLayer *text_layer) {
+  if (!text_layer) return;
+  layer_teardown(&text_layer->layer);
+  host_free(text_layer);
+}
+
+// Docs are in the Pebble SDK.
+Layer *text_layer_get_layer(TextLayer *text_layer) {
+  return &text_layer->layer;
+}
+
+// Docs are in the Pebble SDK.
+void text_layer_set_text(TextLayer *text_layer, const char *text) {
+  text_layer->text = text;
+  layer_mark_dirty(&text_layer->layer);
+}
+
+// Docs are in the Pebble SDK.
+void text_layer_set_text_color(TextLayer *text_layer, GColor color) {
+}
+
+// Docs are in the Pebble SDK.
+void text_layer_set_background_color(TextLayer *text_layer, GColor color) {
+}
+
+// Docs are in the Pebble SDK.
+void text_layer_set_font(TextLayer *text_layer, GFont font) {
+  text_layer->font = font;
+}
+
+// Docs are in the Pebble SDK.
+void text_layer_set_text_alignment(TextLayer *text_layer,
+    GTextAlignment alignment) {
+}
+
+// Docs are in the Pebble SDK.
+Window *window_create(void) {
+  Window *window = host_alloc(sizeof(*window));
+  layer_setup(&window->root,
+      GRect(0, 0, HOST_SCREEN_WIDTH, HOST_SCREEN_HEIGHT));
+  return window;
+}
+
+// Docs are in the Pebble SDK.
+void window_destroy(Window *window) {
+  if (!window) return;
+  if (window->handlers.unload) window->handlers.unload(window);
+  layer_teardown(&window->root);
+  host_free(window);
+}
+
+// Docs are in the Pebble SDK.
+Layer *window_get_root_layer(const Window *window) {
+  return (Layer *) &window->root;
+}
+
+// Docs are in the Pebble SDK.
+void window_set_window_handlers(Window *window, WindowHandlers handlers) {
+  window->handlers = handlers;
+}
+
+// Docs are in the Pebble SDK.
+void window_set_background_color(Window *window, GColor color) {
+}
+
+// Docs are in the Pebble SDK.
+void window_stack_push(Window *window, bool animated) {
+  if (window->handlers.load) window->handlers.load(window);
+}
+
+// Docs are in the Pebble SDK.
+void app_event_loop(void) {
+  // Host programs drive events themselves (see pebble_host.h).
+}
+
+
+/* Timers and event services */
+
+struct AppTimer {
+  uint64_t due_ms;
+  AppTimerCallback callback;
+  void *data;
+  AppTimer *next;  // next in timers, which is sorted by due time
+};
+
+static AppTimer *timers;
+
+static TickHandler tick_handler;
+
+/**
+ * Inserts a timer into the list, keeping it sorted. Timers due at the same
+ * time fire in the order they were scheduled.
+ *
+ * @param timer The timer to insert.
+ */
+static void timer_insert(AppTimer *timer) {
+  AppTimer **link = &timers;
+  while (*link && (*link)->due_ms <= timer->due_ms) link = &(*link)->next;
+  timer->next = *link;
+  *link = timer;
+}
+
+/**
+ * Removes a timer from the list.
+ *
+ * @param timer The timer to remove.
+ * @return True if the timer was scheduled.
+ */
+static bool timer_remove(AppTimer *timer) {
+  for (AppTimer **link = &timers; *link; link = &(*link)->next) {
+    if (*link == timer) {
+      *link = timer->next;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Docs are in the Pebble SDK.
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback,
+    void *callback_data) {
+  host_stats.timers++;
+  AppTimer *timer = host_alloc(sizeof(*timer));
+  timer->due_ms = clock_ms + timeout_ms;
+  timer->callback = callback;
+  timer->data = callback_data;
+  timer_insert(timer);
+  return timer;
+}
+
+// Docs are in the Pebble SDK.
+bool app_timer_reschedule(AppTimer *timer, uint32_t new_timeout_ms) {
+  if (!timer_remove(timer)) return false;
+  timer->due_ms = clock_ms + new_timeout_ms;
+  timer_insert(timer);
+  return true;
+}
+
+// Docs are in the Pebble SDK.
+void app_timer_cancel(AppTimer *timer) {
+  if (timer_remove(timer)) host_free(timer);
+}
+
+// Docs are in pebble_host.h.
+void host_advance_ms(uint32_t ms) {
+  uint64_t target = clock_ms + ms;
+  while (timers && timers->due_ms <= target) {
+    AppTimer *timer = timers;
+    timers = timer->next;
+    clock_ms = timer->due_ms;
+    AppTimerCallback callback = timer->callback;
+    void *data = timer->data;
+    host_free(timer);  // a fired timer's handle is no longer valid
+    callback(data);
+  }
+  clock_ms = target;
+}
+
+// Docs are in the Pebble SDK.
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler) {
+  tick_handler = handler;
+}
+
+// Docs are in the Pebble SDK.
+void tick_timer_service_unsubscribe(void) {
+  tick_handler = NULL;
+}
+
+// Docs are in pebble_host.h.
+void host_fire_tick(TimeUnits units_changed) {
+  if (!tick_handler) return;
+  time_t now = host_time(NULL);
+  tick_handler(localtime(&now), units_changed);
+}
+
+// Docs are in the Pebble SDK.
+void bluetooth_connection_service_subscribe(
+    BluetoothConnectionHandler handler) {
+}
+
+// Docs are in the Pebble SDK.
+void bluetooth_connection_service_unsubscribe(void) {
+}
+
+// Docs are in the Pebble SDK. The emulated phone is always connected.
+bool bluetooth_connection_service_peek(void) {
+  return true;
+}
+
+// Docs are in the Pebble SDK.
+void app_focus_service_subscribe(AppFocusHandler handler) {
+}
+
+// Docs are in the Pebble SDK.
+void app_focus_service_unsubscribe(void) {
+}
+
+// Docs are in the Pebble SDK.
+void accel_tap_service_subscribe(AccelTapHandler handler) {
+}
+
+// Docs are in the Pebble SDK.
+void accel_tap_service_unsubscribe(void) {
+}
+
+
+/* Dictionaries. Same layout as on the watch: a count byte, then tuples of
+ * a 7 byte header (key, type, length) followed by the value. */
+
+#define TUPLE_HEADER_SIZE 7
+
+/**
+ * Finds the tuple after the given one.
+ *
+ * @param tuple A tuple in a serialized dictionary.
+ * @return The address right after its value.
+ */
+static Tuple *tuple_next(const Tuple *tuple) {
+  return (Tuple *) ((const uint8_t *) tuple + TUPLE_HEADER_SIZE +
+      tuple->length);
+}
+
+/**
+ * Appends a tuple at the iterator's cursor.
+ *
+ * @return DICT_NOT_ENOUGH_STORAGE if it doesn't fit, otherwise DICT_OK.
+ */
+static DictionaryResult dict_append(DictionaryIterator *iter, uint32_t key,
+    TupleType type, const void *data, uint16_t length) {
+  uint8_t *cursor = (uint8_t *) iter->cursor;
+  if (cursor + TUPLE_HEADER_SIZE + length > (const uint8_t *) iter->end) {
+    return DICT_NOT_ENOUGH_STORAGE;
+  }
+  Tuple *tuple = iter->cursor;
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value->data, data, length);
+  iter->dictionary->count++;
+  iter->cursor = tuple_next(tuple);
+  return DICT_OK;
+}
+
+// Docs are in the Pebble SDK.
+DictionaryResult dict_write_begin(DictionaryIterator *iter, uint8_t *buffer,
+    const uint16_t size) {
+  if (!iter || !buffer || size < 1) return DICT_INVALID_ARGS;
+  iter->dictionary = (Dictionary *) buffer;
+  iter->dictionary->count = 0;
+  iter->cursor = iter->dictionary->head;
+  iter->end = buffer + size;
+  return DICT_OK;
+}
+
+// Docs are in the Pebble SDK.
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key,
+    const uint8_t * const data, const uint16_t size) {
+  return dict_append(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+// Docs are in the Pebble SDK.
+DictionaryResult dict_write_int(DictionaryIterator *iter, const uint32_t key,
+    const void *integer, const uint8_t width_bytes, const bool is_signed) {
+  if (width_bytes != 1 && width_bytes != 2 && width_bytes != 4) {
+    return DICT_INVALID_ARGS;
+  }
+  return dict_append(iter, key, is_signed ? TUPLE_INT : TUPLE_UINT, integer,
+      width_bytes);
+}
+
+// Docs are in the Pebble SDK.
+DictionaryResult dict_write_int32(DictionaryIterator *iter, const uint32_t key,
+    const int32_t value) {
+  return dict_write_int(iter, key, &value, sizeof(value), true);
+}
+
+// Docs are in the Pebble SDK.
+DictionaryResult dict_write_tuplet(DictionaryIterator *iter,
+    const Tuplet * const tuplet) {
+  switch (tuplet->type) {
+    case TUPLE_BYTE_ARRAY:
+      return dict_append(iter, tuplet->key, tuplet->type, tuplet->bytes.data,
+          tuplet->bytes.length);
+    case TUPLE_CSTRING:
+      return dict_append(iter, tuplet->key, tuplet->type, tuplet->cstring.data,
+          tuplet->cstring.length);
+    default:
+      // Little-endian, so the low bytes of the storage come first:
+      return dict_append(iter, tuplet->key, tuplet->type,
+          &tuplet->integer.storage, tuplet->integer.width);
+  }
+}
+
+// Docs are in the Pebble SDK.
+uint32_t dict_write_end(DictionaryIterator *iter) {
+  iter->end = iter->cursor;
+  return (uint8_t *) iter->cursor - (uint8_t *) iter->dictionary;
+}
+
+// Docs are in the Pebble SDK.
+uint32_t dict_calc_buffer_size(const uint8_t tuple_count, ...) {
+  uint32_t size = sizeof(Dictionary);
+  va_list sizes;
+  va_start(sizes, tuple_count);
+  for (uint8_t i = 0; i < tuple_count; i++) {
+    size += TUPLE_HEADER_SIZE + va_arg(sizes, uint32_t);
+  }
+  va_end(sizes);
+  return size;
+}
+
+// Docs are in the Pebble SDK.
+Tuple *dict_read_begin_from_buffer(DictionaryIterator *iter,
+    const uint8_t * const buffer, const uint16_t size) {
+  if (!iter || !buffer || size < 1) return NULL;
+  iter->dictionary = (Dictionary *) buffer;
+  iter->end = buffer + size;
+  return dict_read_first(iter);
+}
+
+// Docs are in the Pebble SDK.
+Tuple *dict_read_first(DictionaryIterator *iter) {
+  iter->cursor = iter->dictionary->head;
+  if (iter->dictionary->count == 0) return NULL;
+  return dict_read_next(iter);
+}
+
+// Docs are in the Pebble SDK.
+Tuple *dict_read_next(DictionaryIterator *iter) {
+  Tuple *tuple = iter->cursor;
+  const uint8_t *end = iter->end;
+  if ((uint8_t *) tuple + TUPLE_HEADER_SIZE > end) return NULL;
+  Tuple *next = tuple_next(tuple);
+  if ((uint8_t *) next > end) return NULL;
+  iter->cursor = next;
+  return tuple;
+}
+
+// Docs are in the Pebble SDK.
+Tuple *dict_find(const DictionaryIterator *iter, const uint32_t key) {
+  DictionaryIterator walk = *iter;
+  for (Tuple *tuple = dict_read_first(&walk); tuple;
+      tuple = dict_read_next(&walk)) {
+    if (tuple->key == key) return tuple;
+  }
+  return NULL;
+}
+
+
+/* App Message. There's one outbox, and at most one message in flight. */
+
+static AppMessageInboxReceived inbox_received;
+static AppMessageInboxDropped inbox_dropped;
+static AppMessageOutboxSent outbox_sent;
+static AppMessageOutboxFailed outbox_failed;
+
+static uint8_t *outbox_buffer;
+static uint32_t outbox_size;
+static DictionaryIterator outbox_iter;
+static bool outbox_open;       // between outbox_begin and outbox_send
+static bool outbox_in_flight;  // sent, awaiting host_finish_outbox
+
+// Docs are in the Pebble SDK.
+AppMessageResult app_message_open(const uint32_t size_inbound,
+    const uint32_t size_outbound) {
+  free(outbox_buffer);
+  outbox_buffer = malloc(size_outbound);
+  outbox_size = size_outbound;
+  return outbox_buffer ? APP_MSG_OK : APP_MSG_OUT_OF_MEMORY;
+}
+
+// Docs are in the Pebble SDK.
+AppMessageInboxReceived app_message_register_inbox_received(
+    AppMessageInboxReceived received_callback) {
+  AppMessageInboxReceived previous = inbox_received;
+  inbox_received = received_callback;
+  return previous;
+}
+
+// Docs are in the Pebble SDK.
+AppMessageInboxDropped app_message_register_inbox_dropped(
+    AppMessageInboxDropped dropped_callback) {
+  AppMessageInboxDropped previous = inbox_dropped;
+  inbox_dropped = dropped_callback;
+  return previous;
+}
+
+// Docs are in the Pebble SDK.
+AppMessageOutboxSent app_message_register_outbox_sent(
+    AppMessageOutboxSent sent_callback) {
+  AppMessageOutboxSent previous = outbox_sent;
+  outbox_sent = sent_callback;
+  return previous;
+}
+
+// Docs are in the Pebble SDK.
+AppMessageOutboxFailed app_message_register_outbox_failed(
+    AppMessageOutboxFailed failed_callback) {
+  AppMessageOutboxFailed previous = outbox_failed;
+  outbox_failed = failed_callback;
+  return previous;
+}
+
+// Docs are in the Pebble SDK.
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator) {
+  if (!outbox_buffer) return APP_MSG_INVALID_ARGS;
+  if (outbox_open || outbox_in_flight) return APP_MSG_BUSY;
+  dict_write_begin(&outbox_iter, outbox_buffer, outbox_size);
+  outbox_open = true;
+  *iterator = &outbox_iter;
+  return APP_MSG_OK;
+}
+
+// Docs are in the Pebble SDK.
+AppMessageResult app_message_outbox_send(void) {
+  if (!outbox_open) return APP_MSG_INVALID_ARGS;
+  host_stats.messages_sent++;
+  dict_write_end(&outbox_iter);
+  outbox_open = false;
+  outbox_in_flight = true;
+  return APP_MSG_OK;
+}
+
+// Docs are in pebble_host.h.
+bool host_finish_outbox(AppMessageResult result) {
+  if (!outbox_in_flight) return false;
+  outbox_in_flight = false;
+  dict_read_first(&outbox_iter);
+  if (result == APP_MSG_OK) {
+    if (outbox_sent) outbox_sent(&outbox_iter, NULL);
+  } else if (outbox_failed) {
+    outbox_failed(&outbox_iter, result, NULL);
+  }
+  return true;
+}
+
+// Docs are in pebble_host.h.
+void host_receive_message(const uint8_t *buffer, uint16_t size) {
+  if (!inbox_received) return;
+  DictionaryIterator iter;
+  dict_read_begin_from_buffer(&iter, buffer, size);
+  inbox_received(&iter, NULL);
+}
+
+
+/* Persistent storage */
+
+#define HOST_PERSIST_CAPACITY 64
+
+typedef struct {
+  uint32_t key;
+  uint16_t length;
+  bool used;
+  uint8_t data[PERSIST_DATA_MAX_LENGTH];
+} PersistEntry;
+
+static PersistEntry persist_entries[HOST_PERSIST_CAPACITY];
+
+/**
+ * Finds the stored entry for a key.
+ *
+ * @return The entry, or NULL if nothing is stored under the key.
+ */
+static PersistEntry *persist_find(uint32_t key) {
+  for (int i = 0; i < HOST_PERSIST_CAPACITY; i++) {
+    if (persist_entries[i].used && persist_entries[i].key == key) {
+      return &persist_entries[i];
+    }
+  }
+  return NULL;
+}
+
+// Docs are in the Pebble SDK.
+bool persist_exists(const uint32_t key) {
+  return persist_find(key) != NULL;
+}
+
+// Docs are in the Pebble SDK.
+int persist_read_data(const uint32_t key, void *buffer,
+    const size_t buffer_size) {
+  PersistEntry *entry = persist_find(key);
+  if (!entry) return E_DOES_NOT_EXIST;
+  size_t length = entry->length < buffer_size ? entry->length : buffer_size;
+  memcpy(buffer, entry->data, length);
+  return length;
+}
+
+// Docs are in the Pebble SDK.
+int persist_write_data(const uint32_t key, const void *data,
+    const size_t size) {
+  host_stats.persist_writes++;
+  PersistEntry *entry = persist_find(key);
+  for (int i = 0; !entry && i < HOST_PERSIST_CAPACITY; i++) {
+    if (!persist_entries[i].used) entry = &persist_entries[i];
+  }
+  if (!entry) return E_OUT_OF_STORAGE;
+  size_t length = size < PERSIST_DATA_MAX_LENGTH ?
+      size : PERSIST_DATA_MAX_LENGTH;
+  entry->key = key;
+  entry->used = true;
+  entry->length = length;
+  memcpy(entry->data, data, length);
+  return length;
+}
+
+// Docs are in the Pebble SDK.
+status_t persist_delete(const uint32_t key) {
+  PersistEntry *entry = persist_find(key);
+  if (!entry) return E_DOES_NOT_EXIST;
+  entry->used = false;
+  return S_SUCCESS;
+}
@@ -0,0 +1,106 @@
+/**
+ * @section DESCRIPTION
+ *
+ * The harness side of the host Pebble stub (see pebble.h): counters for what
+ * the app asked the "OS" to do, plus hooks to drive the things the OS would
+ * normally drive, like the clock, timers and redraws. Only host programs
+ * (benchmarks, tools) include this; the app itself never does.
+ */
+
+#ifndef __PEBBLE_HOST_H__
+#define __PEBBLE_HOST_H__
+
+#include <pebble.h>
+
+
+/** Screen size of the emulated watch. */
+#define HOST_SCREEN_WIDTH 144
+#define HOST_SCREEN_HEIGHT 168
+
+/** 
+ * Heap the emulated app has, for heap_bytes_free: what an Aplite app has 
+ * left when its code and static data fill the memory budget (see wscript).
+ */
+#define HOST_HEAP_SIZE (6 * 1024)
+
+/**
+ * Running totals of stub calls, reset by host_reset_stats. Allocations are
+ * anything the stub allocates on the app's behalf: layers, fonts, bitmaps,
+ * timers, windows.
+ */
+typedef struct {
+  uint32_t allocs;          // stub objects created
+  uint32_t frees;           // stub objects destroyed
+  uint32_t dirty_marks;     // layer_mark_dirty calls
+  uint32_t redraws;         // update procs run by host_render
+  uint32_t text_draws;      // graphics_draw_text calls
+  uint32_t messages_sent;   // app_message_outbox_send calls
+  uint32_t persist_writes;  // persist_write_* calls
+  uint32_t timers;          // app_timer_register calls
+  uint32_t logs;            // APP_LOG calls, printed or not
+} HostStats;
+
+extern HostStats host_stats;
+
+/**
+ * Zeroes host_stats. Doesn't touch any stub state (layers, timers, etc.).
+ */
+void host_reset_stats(void);
+
+/**
+ * Turns printing of APP_LOG output on or off. It's on by default; benchmarks
+ * turn it off so they measure the app rather than the terminal.
+ *
+ * @param enabled True to print log lines to stderr.
+ */
+void host_set_log_output(bool enabled);
+
+/**
+ * Sets the fake wall clock that time() and time_ms() read.
+ *
+ * @param now The new time, in seconds since the epoch.
+ */
+void host_set_time(time_t now);
+
+/**
+ * Moves the fake clock forward, firing every AppTimer that falls due on the
+ * way, in order.
+ *
+ * @param ms How far to move the clock, in milliseconds.
+ */
+void host_advance_ms(uint32_t ms);
+
+/**
+ * Calls the subscribed TickHandler, if any, with the current fake time.
+ *
+ * @param units_changed The units to report as changed.
+ */
+void host_fire_tick(TimeUnits units_changed);
+
+/**
+ * Runs the update proc of every visible layer that was marked dirty since
+ * the last render, like the OS does before the next frame. Each run counts
+ * as one redraw.
+ */
+void host_render(void);
+
+/**
+ * Finishes the App Message in flight, the way the phone's ACK or NACK would,
+ * by calling the registered sent or failed handler.
+ *
+ * @param result APP_MSG_OK to report success, or the failure reason.
+ * @return True if a message was in flight.
+ */
+bool host_finish_outbox(AppMessageResult result);
+
+/**
+ * Hands a serialized dictionary to the registered inbox received handler,
+ * as if it had just arrived from the phone.
+ *
+ * @param buffer The serialized dictionary.
+ * @param size Size of the dictionary in bytes.
+ */
+void host_receive_message(const uint8_t *buffer, uint16_t size);
+
+
+#endif  // __PEBBLE_HOST_H__
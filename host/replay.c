@@ -0,0 +1,225 @@
+/**
+ * @section DESCRIPTION
+ *
+ * Replays a recorded App Message trace through the watch code on the host,
+ * to reproduce and profile real sessions offline. Messages go through the
+ * same path as on the watch (transfer reassembly, then the New Relic
+ * handler), with the fake clock following the recorded timestamps, so
+ * staleness and history behave as they did. After each message the screen
+ * is rendered and the cost of the message is printed.
+ *
+ * Traces come from the phone's TrafficRecorder (turn on tracing in the
+ * watchface settings, then capture `pebble logs`). Any line holding
+ * "TRACE <seq> <ms> <hex>" is replayed; everything else is skipped. Records
+ * with a sequence number at or below the last one replayed are skipped too, 
+ * so a log that holds some records twice (the stored trace logged at startup
+ * after a live capture) replays each once.
+ *
+ * Usage: replay [-v] [-s speed] trace.log
+ *   -s speed  0 (default) replays as fast as possible, 1 at recorded speed,
+ *             N at N times recorded speed. Clock-driven behaviour is the
+ *             same either way.
+ *   -v        Print the watch's APP_LOG output.
+ */
+
+// For nanosleep and clock_gettime:
+#define _POSIX_C_SOURCE 199309L
+
+#include <pebble.h>
+#include <unistd.h>
+#include "pebble_host.h"
+#include "newrelic_layer.h"
+#include "outbox_queue.h"
+#include "transfer.h"
+
+
+/** Longest trace line we can handle: a whole serialized chunk, in hex. */
+#define MAX_LINE_LENGTH 1024
+
+/** Totals over the whole replay. */
+static struct {
+  uint32_t messages;
+  uint64_t total_ns;
+  uint64_t max_ns;
+} totals;
+
+/**
+ * Returns a monotonic timestamp.
+ *
+ * @return Nanoseconds from an arbitrary starting point.
+ */
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * Sleeps for a while, to replay at recorded speed.
+ *
+ * @param ms How long to sleep, in milliseconds.
+ */
+static void sleep_ms(uint64_t ms) {
+  struct timespec ts = {
+    .tv_sec = ms / 1000,
+    .tv_nsec = (ms % 1000) * 1000000,
+  };
+  nanosleep(&ts, NULL);
+}
+
+/**
+ * The AppMessageInboxReceived handler, dispatching like main.c does.
+ */
+static void received_handler(DictionaryIterator *iter, void *context) {
+  DictionaryIterator *message = transfer_receive(iter);
+  if (message) newrelic_app_msg_in_received_handler(message, context);
+}
+
+/**
+ * Parses a trace line.
+ *
+ * @param line The line, as read from the log.
+ * @param seq Output for the record's sequence number.
+ * @param time_ms Output for the record's timestamp.
+ * @param data Output for the serialized message.
+ * @param size Output for the size of the message in bytes.
+ * @return True if the line was a valid trace record.
+ */
+static bool parse_line(const char *line, uint32_t *seq, uint64_t *time_ms,
+    uint8_t *data, uint16_t *size) {
+  const char *record = strstr(line, "TRACE ");
+  if (!record) return false;
+  unsigned long parsed_seq;
+  unsigned long long parsed_time;
+  int hex_start;
+  if (sscanf(record, "TRACE %lu %llu %n", &parsed_seq, &parsed_time, 
+        &hex_start) != 2) {
+    return false;
+  }
+  const char *hex = record + hex_start;
+  uint16_t length = 0;
+  unsigned int byte;
+  while (length < MAX_LINE_LENGTH / 2 && sscanf(hex, "%2x", &byte) == 1) {
+    data[length++] = byte;
+    hex += 2;
+  }
+  if (length == 0) return false;
+  *seq = parsed_seq;
+  *time_ms = parsed_time;
+  *size = length;
+  return true;
+}
+
+/**
+ * Replays one message and prints what it cost.
+ *
+ * @param offset_ms Time of the message since the start of the trace.
+ * @param data The serialized message.
+ * @param size Size of the message in bytes.
+ */
+static void replay_message(uint64_t offset_ms, const uint8_t *data,
+    uint16_t size) {
+  host_reset_stats();
+  uint64_t start = now_ns();
+  host_receive_message(data, size);
+  host_render();
+  uint64_t elapsed = now_ns() - start;
+
+  // Anything the watch sent back (update requests, NACKs) is acked by the
+  // "phone" right away:
+  while (host_finish_outbox(APP_MSG_OK)) {}
+
+  totals.messages++;
+  totals.total_ns += elapsed;
+  if (elapsed > totals.max_ns) totals.max_ns = elapsed;
+  printf("%9.3fs %4d bytes  key %3d  %8.1f us  %d dirty  %d redraws"
+      "  %d allocs\n", offset_ms / 1000.0, size, size > 1 ? data[1] : -1,
+      elapsed / 1000.0,
+      (int) host_stats.dirty_marks, (int) host_stats.redraws,
+      (int) host_stats.allocs);
+}
+
+int main(int argc, char **argv) {
+  double speed = 0;
+  bool verbose = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "s:v")) != -1) {
+    switch (opt) {
+      case 's':
+        speed = atof(optarg);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-v] [-s speed] trace.log\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind != argc - 1) {
+    fprintf(stderr, "Usage: %s [-v] [-s speed] trace.log\n", argv[0]);
+    return 2;
+  }
+  FILE *trace = fopen(argv[optind], "r");
+  if (!trace) {
+    perror(argv[optind]);
+    return 1;
+  }
+  host_set_log_output(verbose);
+
+  char line[MAX_LINE_LENGTH + 64];
+  uint8_t data[MAX_LINE_LENGTH / 2];
+  uint16_t size;
+  uint64_t first_ms = 0;
+  uint64_t last_ms = 0;
+  uint32_t last_seq = 0;
+  bool started = false;
+  Layer *root = NULL;
+  Layer *parent = NULL;
+  while (fgets(line, sizeof(line), trace)) {
+    uint32_t seq;
+    uint64_t time_ms;
+    if (!parse_line(line, &seq, &time_ms, data, &size)) continue;
+    if (started && seq <= last_seq) continue;  // replayed already
+
+    if (!started) {
+      // Start the watch at the time of the first message:
+      host_set_time(time_ms / 1000);
+      app_message_register_inbox_received(received_handler);
+      app_message_register_outbox_sent(outbox_queue_handle_sent);
+      app_message_register_outbox_failed(outbox_queue_handle_failed);
+      app_message_open(NEWRELIC_INBOX_SIZE, NEWRELIC_OUTBOX_SIZE);
+      root = layer_create(GRect(0, 0, HOST_SCREEN_WIDTH, HOST_SCREEN_HEIGHT));
+      parent = layer_create(GRect(0, 84, HOST_SCREEN_WIDTH, 84));
+      layer_add_child(root, parent);
+      newrelic_layer_init(parent);
+      host_render();
+      while (host_finish_outbox(APP_MSG_OK)) {}
+      first_ms = last_ms = time_ms;
+      started = true;
+    }
+
+    // Clocks can step backwards; the watch's doesn't:
+    uint64_t gap_ms = time_ms > last_ms ? time_ms - last_ms : 0;
+    if (speed > 0) sleep_ms(gap_ms / speed);
+    host_advance_ms(gap_ms);
+    last_ms += gap_ms;
+    last_seq = seq;
+    replay_message(last_ms - first_ms, data, size);
+  }
+  fclose(trace);
+
+  if (!started) {
+    fprintf(stderr, "No trace records found.\n");
+    return 1;
+  }
+  printf("\n%d messages over %.1fs: %.1f us avg, %.1f us max\n",
+      (int) totals.messages, (last_ms - first_ms) / 1000.0,
+      totals.total_ns / 1000.0 / totals.messages, totals.max_ns / 1000.0);
+
+  newrelic_layer_deinit();
+  layer_destroy(parent);
+  layer_destroy(root);
+  outbox_queue_deinit();
+  return 0;
+}
@@ -6,6 +6,17 @@
 NEWRELIC_API_URL = 'https://api.newrelic.com/v2';
 /** Maximum amount of time (in ms) to wait for New Relic API responses. */
 AJAX_TIMEOUT = 30000;
+/** Max number of apps the watch can show. Must match the watch app JS. */
+MAX_APPS = 12;
+/** How long (in ms) a fetched app list is reused for the same API key. */
+APP_LIST_CACHE_TTL = 30 * 60 * 1000;
+/** 
+ * Max number of apps listed at once. Phone webviews get slow with thousands
+ * of options; the filter narrows things down from there.
+ */
+APP_LIST_MAX_SHOWN = 300;
+/** Delay (in ms) after the last keystroke before the app filter is applied. */
+APP_FILTER_DELAY = 150;
 
 
 /***************************
@@ -21,19 +32,79 @@ AJAX_TIMEOUT = 30000;
  *        two components.
  * @this {Options}
  * @param {string} apiKey The user's New Relic API key.
- * @param {string} appId The New Relic app ID (digits only) of the New Relic
- *        app the user wants to monitor.
+ * @param {Array} appIds The New Relic app IDs (digits only) of the New Relic
+ *        apps the user wants to monitor, at most MAX_APPS. The first one is
+ *        the primary app, whose history the watch keeps.
  * @param {number} updateFreq The frequency (in minutes) with which we should
  *        fetch new New Relic data.
+ * @param {boolean} adaptive Whether to adapt the update frequency to how 
+ *        much the metrics are moving, instead of always using updateFreq.
+ * @param {number} minFreq Fastest adaptive update frequency (in minutes).
+ * @param {number} maxFreq Slowest adaptive update frequency (in minutes).
+ * @param {number} apdexFloor Adaptive mode polls at minFreq while apdex is 
+ *        below this.
+ * @param {number} errorRateCeiling Adaptive mode polls at minFreq while the
+ *        error rate (%) is above this.
+ * @param {number} cacheMaxAge Cached data up to this many minutes old is shown
+ *        on the watch while fresh data is fetched.
+ * @param {boolean} seriesMode Whether to also fetch a time series of one 
+ *        metric of the first app for the watch to chart.
+ * @param {string} seriesMetric The metric to chart: response_time or 
+ *        throughput.
+ * @param {number} seriesWindow The time window to chart, in minutes.
+ * @param {boolean} traceMode Whether to record App Message traffic on the 
+ *        phone and watch, for debugging.
+ * @param {string} logLevel The least severe messages the watch app JS logs:
+ *        error, warning, info or debug.
  */
-function Options(apiKey, appId, updateFreq) {
+function Options(apiKey, appIds, updateFreq, adaptive, minFreq, maxFreq, 
+    apdexFloor, errorRateCeiling, cacheMaxAge, seriesMode, seriesMetric, 
+    seriesWindow, traceMode, logLevel) {
   this.apiKey = apiKey;
-  this.appId = appId;
+  this.appIds = appIds || [];
   this.updateFreq = updateFreq || Options.DEFAULT_UPDATE_FREQ;
+  this.adaptive = !!adaptive;
+  this.minFreq = minFreq || Options.DEFAULT_MIN_FREQ;
+  this.maxFreq = maxFreq || Options.DEFAULT_MAX_FREQ;
+  this.apdexFloor = Options.valueOr(apdexFloor, Options.DEFAULT_APDEX_FLOOR);
+  this.errorRateCeiling = Options.valueOr(errorRateCeiling, 
+      Options.DEFAULT_ERROR_RATE_CEILING);
+  this.cacheMaxAge = cacheMaxAge || Options.DEFAULT_CACHE_MAX_AGE;
+  this.seriesMode = !!seriesMode;
+  this.seriesMetric = seriesMetric || Options.DEFAULT_SERIES_METRIC;
+  this.seriesWindow = seriesWindow || Options.DEFAULT_SERIES_WINDOW;
+  this.traceMode = !!traceMode;
+  this.logLevel = logLevel || Options.DEFAULT_LOG_LEVEL;
 }
 
 /** A default value for the update frequency option. */
 Options.DEFAULT_UPDATE_FREQ = 5;
+/** Defaults for the adaptive update frequency options. */
+Options.DEFAULT_MIN_FREQ = 1;
+Options.DEFAULT_MAX_FREQ = 30;
+Options.DEFAULT_APDEX_FLOOR = 0.85;
+Options.DEFAULT_ERROR_RATE_CEILING = 1;
+/** Longest update frequency the watch accepts (in minutes): a day. */
+Options.MAX_FREQ = 1440;
+/** A default value for the cache max age option. */
+Options.DEFAULT_CACHE_MAX_AGE = 60;
+/** Defaults for the time series options. */
+Options.DEFAULT_SERIES_METRIC = 'response_time';
+Options.DEFAULT_SERIES_WINDOW = 60;
+/** A default value for the log level option. */
+Options.DEFAULT_LOG_LEVEL = 'warning';
+
+/**
+ * Picks an option's value, or its default if it's missing. Unlike ||, keeps
+ * a 0, for options where 0 is a legal value.
+ *
+ * @param value The option's value.
+ * @param fallback The option's default.
+ * @return value, or fallback if value is undefined or null.
+ */
+Options.valueOr = function(value, fallback) {
+  return (value === undefined || value === null) ? fallback : value;
+}
 
 /**
  * Displays these config options on the page.
@@ -43,8 +114,23 @@ Options.DEFAULT_UPDATE_FREQ = 5;
 Options.prototype.display = function() {
   console.log('Loaded options: ' + JSON.stringify(this));
   $('#api-key').val(this.apiKey);
-  $('#app-selector').val(this.appId).change();
+  $('#app-selector').val(this.appIds).change();
   $('#update-freq').val(this.updateFreq || Options.DEFAULT_UPDATE_FREQ);
+  $('#adaptive').prop('checked', !!this.adaptive);
+  $('#adaptive-settings').toggle(!!this.adaptive);
+  $('#min-freq').val(this.minFreq || Options.DEFAULT_MIN_FREQ);
+  $('#max-freq').val(this.maxFreq || Options.DEFAULT_MAX_FREQ);
+  $('#apdex-floor').val(
+      Options.valueOr(this.apdexFloor, Options.DEFAULT_APDEX_FLOOR));
+  $('#error-rate-ceiling').val(Options.valueOr(this.errorRateCeiling, 
+      Options.DEFAULT_ERROR_RATE_CEILING));
+  $('#cache-max-age').val(this.cacheMaxAge || Options.DEFAULT_CACHE_MAX_AGE);
+  $('#series-mode').prop('checked', !!this.seriesMode);
+  $('#series-settings').toggle(!!this.seriesMode);
+  $('#series-metric').val(this.seriesMetric || Options.DEFAULT_SERIES_METRIC);
+  $('#series-window').val(this.seriesWindow || Options.DEFAULT_SERIES_WINDOW);
+  $('#trace-mode').prop('checked', !!this.traceMode);
+  $('#log-level').val(this.logLevel || Options.DEFAULT_LOG_LEVEL);
 }
 
 /**
@@ -55,8 +141,19 @@ Options.prototype.display = function() {
 Options.getCurrentOptions = function() {
   return new Options(
     $('#api-key').val(), 
-    $('#app-selector').val(),
-    $('#update-freq').val()
+    selectedAppIds,
+    $('#update-freq').val(),
+    $('#adaptive').prop('checked'),
+    $('#min-freq').val(),
+    $('#max-freq').val(),
+    $('#apdex-floor').val(),
+    $('#error-rate-ceiling').val(),
+    $('#cache-max-age').val(),
+    $('#series-mode').prop('checked'),
+    $('#series-metric').val(),
+    $('#series-window').val(),
+    $('#trace-mode').prop('checked'),
+    $('#log-level').val()
   );
 }
 
@@ -69,14 +166,197 @@ Options.getSavedOptions = function() {
   var options = JSON.parse(decodeURIComponent(
         window.location.hash.substring(1)) || '{}');
   options.__proto__ = Options.prototype;
+  // Options saved before multi-app support have a single appId:
+  if (!options.appIds) options.appIds = options.appId ? [options.appId] : [];
   return options;
 }
 
 
+/***********
+ * App list:
+ ***********/
+
+/**
+ * Creates an instance of AppList.
+ *
+ * @class The New Relic apps available under one API key. The API returns
+ *        them a page at a time, linking each page to the next; pages are 
+ *        handed out as they arrive so the list can be shown before it's
+ *        complete. Complete lists are cached in localStorage per API key for
+ *        APP_LIST_CACHE_TTL.
+ * @this {AppList}
+ * @param {string} apiKey The New Relic API key to list apps for.
+ */
+function AppList(apiKey) {
+  this.apiKey = apiKey;
+  this.apps = [];          // { id, name, match } in API order; match is the
+                           // lowercased text the filter searches
+  this.complete = false;   // whether every page has arrived
+  this.cancelled = false;  // set when a newer list replaces this one
+}
+
+/**
+ * Hashes a string (djb2), so API keys don't end up in localStorage keys.
+ *
+ * @param {string} str The string to hash.
+ * @return {string} The hash, in base 36.
+ */
+AppList.hash = function(str) {
+  var hash = 5381;
+  for (var i = 0; i < str.length; i++) {
+    hash = ((hash * 33) ^ str.charCodeAt(i)) >>> 0;
+  }
+  return hash.toString(36);
+}
+
+/**
+ * Returns the URL of the next page from a response's Link header, if any.
+ *
+ * @param {Object} jqXHR The response.
+ * @return {string} The next page's URL, or null on the last page.
+ */
+AppList.nextPageUrl = function(jqXHR) {
+  var links = (jqXHR.getResponseHeader('Link') || '').split(',');
+  for (var i = 0; i < links.length; i++) {
+    var match = /<([^>]+)>\s*;\s*rel="?next"?/.exec(links[i]);
+    if (match) return match[1];
+  }
+  return null;
+}
+
+/**
+ * Adds apps from an API response to the list.
+ *
+ * @this {AppList}
+ * @param {Array} applications Apps as returned by the API, or as cached.
+ * @return {Array} The apps added, in list form.
+ */
+AppList.prototype.add = function(applications) {
+  var added = (applications || []).map(function(app) {
+    var id = String(app['id']);
+    var name = String(app['name']);
+    return { id: id, name: name, match: (name + ' ' + id).toLowerCase() };
+  });
+  this.apps = this.apps.concat(added);
+  return added;
+}
+
+/**
+ * Loads the list from the cache, if it was cached recently enough.
+ *
+ * @this {AppList}
+ * @return {boolean} Whether the list was loaded.
+ */
+AppList.prototype.loadCached = function() {
+  var cached;
+  try {
+    cached = JSON.parse(window.localStorage.getItem(
+        'apps-' + AppList.hash(this.apiKey)));
+  } catch (err) {
+    cached = null;
+  }
+  if (!cached || Date.now() - cached.fetchedAt > APP_LIST_CACHE_TTL) {
+    return false;
+  }
+  this.add(cached.apps);
+  this.complete = true;
+  return true;
+}
+
+/**
+ * Caches the complete list, dropping expired lists of other keys.
+ *
+ * @this {AppList}
+ */
+AppList.prototype.save = function() {
+  var now = Date.now();
+  for (var i = window.localStorage.length - 1; i >= 0; i--) {
+    var key = window.localStorage.key(i);
+    if (key.indexOf('apps-') != 0) continue;
+    try {
+      var cached = JSON.parse(window.localStorage.getItem(key));
+      if (now - cached.fetchedAt <= APP_LIST_CACHE_TTL) continue;
+    } catch (err) {}
+    window.localStorage.removeItem(key);
+  }
+  try {
+    window.localStorage.setItem('apps-' + AppList.hash(this.apiKey),
+      JSON.stringify({
+        fetchedAt: now,
+        apps: this.apps.map(function(app) {
+          return { id: app.id, name: app.name };
+        }),
+      }));
+  } catch (err) {
+    console.log('Could not cache app list: ' + err.message);
+  }
+}
+
+/**
+ * Fetches the whole list, following the API's pagination.
+ *
+ * @this {AppList}
+ * @param {function(Array)} onPage Called with the apps of each page.
+ * @param {function()} onDone Called once the last page has arrived.
+ * @param {function(Object, string)} onError Called with the failed response
+ *        and the error if a page can't be fetched.
+ */
+AppList.prototype.fetch = function(onPage, onDone, onError) {
+  this.fetchPage(NEWRELIC_API_URL + '/applications.json', onPage, onDone,
+      onError);
+}
+
+/**
+ * Fetches one page of the list, then the next one.
+ *
+ * @this {AppList}
+ * @param {string} url The page's URL.
+ * @param {function(Array)} onPage As in fetch.
+ * @param {function()} onDone As in fetch.
+ * @param {function(Object, string)} onError As in fetch.
+ */
+AppList.prototype.fetchPage = function(url, onPage, onDone, onError) {
+  var list = this;
+  $.ajax({
+    url: url,
+    headers: { 'X-Api-Key': this.apiKey },
+    dataType: 'json',
+    timeout: AJAX_TIMEOUT,
+  })
+  .done(function(data, textStatus, jqXHR) {
+    if (list.cancelled) return;
+    onPage(list.add(data['applications']));
+    var next = AppList.nextPageUrl(jqXHR);
+    if (next) {
+      list.fetchPage(next, onPage, onDone, onError);
+    } else {
+      list.complete = true;
+      list.save();
+      onDone();
+    }
+  })
+  .fail(function(jqXHR, textStatus, errorThrown) {
+    if (!list.cancelled) onError(jqXHR, errorThrown);
+  });
+}
+
+
 /*******************
  * Field population:
  *******************/
 
+/** The app list for the current API key. */
+var appList = null;
+
+/** 
+ * IDs of the apps the user has selected. Kept apart from the selector, 
+ * since selected apps may be on a page that hasn't arrived yet.
+ */
+var selectedAppIds = [];
+
+/** IDs of the apps currently in the selector, as keys of an object. */
+var shownAppIds = {};
+
 /**
  * Displays the given error message on the API Key input field.
  *
@@ -97,47 +377,104 @@ function clearKeyError() {
   $('#api-key-error-container').removeClass('error');
 }
 
+/**
+ * Creates a selector option for an app.
+ *
+ * @param {Object} app The app, as held in AppList.
+ * @return {Option} The option, selected if the app is.
+ */
+function createAppOption(app) {
+  var selected = selectedAppIds.indexOf(app.id) >= 0;
+  return new Option(app.name, app.id, selected, selected);
+}
+
+/**
+ * Adds apps to the selector if they match the filter, in one DOM insert. 
+ * Selected apps are always shown. At most APP_LIST_MAX_SHOWN apps are shown.
+ *
+ * @param {Array} apps The apps to add, as held in AppList.
+ */
+function appendAppOptions(apps) {
+  var filter = $('#app-filter').val().trim().toLowerCase();
+  var shownCount = Object.keys(shownAppIds).length;
+  var fragment = document.createDocumentFragment();
+  var hidden = 0;
+  apps.forEach(function(app) {
+    if (shownAppIds[app.id]) return;
+    var selected = selectedAppIds.indexOf(app.id) >= 0;
+    if (!selected && app.match.indexOf(filter) < 0) return;
+    if (!selected && shownCount >= APP_LIST_MAX_SHOWN) {
+      hidden++;
+      return;
+    }
+    fragment.appendChild(createAppOption(app));
+    shownAppIds[app.id] = true;
+    shownCount++;
+  });
+  $('#app-selector')[0].appendChild(fragment);
+  if (hidden) {
+    $('#app-filter-hint').text('Showing the first ' + APP_LIST_MAX_SHOWN + 
+        ' matches. Type to narrow them down.');
+  }
+}
+
+/**
+ * Rebuilds the selector from the app list, e.g. after the filter changed.
+ */
+function renderAppOptions() {
+  $('#app-selector').empty();
+  $('#app-filter-hint').text('');
+  shownAppIds = {};
+  if (appList) appendAppOptions(appList.apps);
+}
+
+/**
+ * Enables the save button if at least one app is selected.
+ */
+function updateSaveButton() {
+  $('#save-button').prop('disabled', !selectedAppIds.length);
+}
+
 /** 
- * Populates the app selection dropdown with all apps available in the 
- * New Relic listing under the currently configured API key.
+ * Populates the app selection list with all apps available in the 
+ * New Relic listing under the currently configured API key. Recently 
+ * fetched lists are reused; otherwise pages are shown as they arrive.
  */
 function populateAppList() {
   var apiKey = $('#api-key').val();
+  if (appList) appList.cancelled = true;
+  appList = null;
+  // Try to restore the saved options as the default selection:
+  selectedAppIds = Options.getSavedOptions().appIds.map(String);
+  renderAppOptions();
   $('#app-selector').prop('disabled', true);
-  $('#app-selector').val('').change();
+  updateSaveButton();
   if (!apiKey) {
     displayKeyError('Please enter your API key.');
     return;
-  } else {
-    displayKeyError('Checking key...');
   }
 
-  $.ajax({
-    url: NEWRELIC_API_URL + '/applications.json',
-    headers: { 'X-Api-Key': apiKey },
-    dataType: 'json',
-    timeout: AJAX_TIMEOUT,
-  })
-  .done(function(data) {
+  var list = appList = new AppList(apiKey);
+  if (list.loadCached()) {
     clearKeyError();
-    // Wipe the current options and insert all the new ones:
-    $('#app-selector').empty();
-    $('#app-selector').val('').change();
-    $(data['applications']).each(function() {
-      $('<option />', {
-        val: this['id'],
-        text: this['name'],
-      }).appendTo($('#app-selector'));
-    })
+    renderAppOptions();
     $('#app-selector').prop('disabled', false);
-    // Try to restore the saved option as a default selection:
-    var options = Options.getSavedOptions();
-    $('#app-selector').val(options.appId).change();
-  })
-  .fail(function(jqXHR, textStatus, errorThrown) {
-    $('#app-selector').empty();
-    $('#app-selector').val('').change();
+    return;
+  }
+  displayKeyError('Checking key...');
+  list.fetch(function(apps) {
+    clearKeyError();
+    appendAppOptions(apps);
+    $('#app-selector').prop('disabled', false);
+  }, function() {
+    console.log('Fetched ' + list.apps.length + ' New Relic apps.');
+  }, function(jqXHR, errorThrown) {
     console.log('Failed to fetch New Relic app list: ' + errorThrown);
+    if (list.apps.length) {
+      // Keep what we have; the rest may show up next time:
+      displayKeyError('Unable to fetch the whole New Relic app list!');
+      return;
+    }
     switch (jqXHR.status) {
       case 401:
         displayKeyError('Invalid API key!');
@@ -152,11 +489,24 @@ function populateAppList() {
   });
 }
 
+/**
+ * Shows the last performance stats the watch sent, if any. The phone passes
+ * them along with the saved options; they aren't an option themselves.
+ *
+ * @param {string} text The stats as formatted by the phone, or empty.
+ */
+function displayWatchStats(text) {
+  $('#watch-stats').text(text || '');
+  $('#watch-stats-container').toggle(!!text);
+}
+
 /**
  * Try to restore the last-known state on document ready.
  */
 $('document').ready(function() {
-  Options.getSavedOptions().display();
+  var options = Options.getSavedOptions();
+  options.display();
+  displayWatchStats(options.watchStats);
   populateAppList();
 });
 
@@ -193,14 +543,29 @@ $('document').ready(function() {
   });
 
   /**
-   * Disable the save button if configuration is incomplete.
+   * Track the selection, keeping it within what the watch can show, and 
+   * disable the save button if configuration is incomplete. Selected apps 
+   * that aren't in the selector (not fetched yet) stay selected.
    */
   $('#app-selector').change(function() {
-    if ($(this).val()) {
-      $('#save-button').prop('disabled', false);
-    } else {
-      $('#save-button').prop('disabled', true);
+    var appIds = selectedAppIds.filter(function(id) {
+      return !shownAppIds[id];
+    }).concat($(this).val() || []);
+    if (appIds.length > MAX_APPS) {
+      appIds = appIds.slice(0, MAX_APPS);
+      $(this).val(appIds);
     }
+    selectedAppIds = appIds;
+    updateSaveButton();
+  });
+
+  /**
+   * Narrow down the app list as the user types, without refetching it.
+   */
+  var filterTimer = null;
+  $('#app-filter').on('input', function() {
+    clearTimeout(filterTimer);
+    filterTimer = setTimeout(renderAppOptions, APP_FILTER_DELAY);
   });
 
   /**
@@ -210,10 +575,63 @@ $('document').ready(function() {
   $('#update-freq').change(function() {
     var parsedUpdateFreq = parseInt($(this).val());
     if (parsedUpdateFreq && parsedUpdateFreq >= 1) {
-      $(this).val(parsedUpdateFreq);
+      $(this).val(Math.min(parsedUpdateFreq, Options.MAX_FREQ));
     } else {
       $(this).val(Options.DEFAULT_UPDATE_FREQ);
     }
   });
 
+  /**
+   * Clean up cache max age entries for the user.
+   */
+  $('#cache-max-age').change(function() {
+    var parsedMaxAge = parseInt($(this).val());
+    if (parsedMaxAge && parsedMaxAge >= 1) {
+      $(this).val(parsedMaxAge);
+    } else {
+      $(this).val(Options.DEFAULT_CACHE_MAX_AGE);
+    }
+  });
+
+  /**
+   * Clean up time series window entries for the user.
+   */
+  $('#series-window').change(function() {
+    var parsedWindow = parseInt($(this).val());
+    if (parsedWindow && parsedWindow >= 1) {
+      $(this).val(parsedWindow);
+    } else {
+      $(this).val(Options.DEFAULT_SERIES_WINDOW);
+    }
+  });
+
+  /**
+   * Only show time series settings when the time series is on.
+   */
+  $('#series-mode').change(function() {
+    $('#series-settings').toggle($(this).prop('checked'));
+  });
+
+  /**
+   * Only show adaptive update settings when adaptive mode is on.
+   */
+  $('#adaptive').change(function() {
+    $('#adaptive-settings').toggle($(this).prop('checked'));
+  });
+
+  /**
+   * Keep the adaptive frequency bounds valid: whole minutes up to MAX_FREQ,
+   * min <= max.
+   */
+  $('#min-freq, #max-freq').change(function() {
+    var minFreq = parseInt($('#min-freq').val());
+    if (!(minFreq >= 1)) minFreq = Options.DEFAULT_MIN_FREQ;
+    minFreq = Math.min(minFreq, Options.MAX_FREQ);
+    var maxFreq = parseInt($('#max-freq').val());
+    if (!(maxFreq >= 1)) maxFreq = Options.DEFAULT_MAX_FREQ;
+    maxFreq = Math.min(maxFreq, Options.MAX_FREQ);
+    $('#min-freq').val(minFreq);
+    $('#max-freq').val(Math.max(minFreq, maxFreq));
+  });
+
 });
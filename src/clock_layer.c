@@ -1,24 +1,96 @@
 #include <pebble.h>
 #include "clock_layer.h"
+#include "resource_cache.h"
+#include "perf_stats.h"
+#include "digit_atlas.h"
 
 
-/** Child layers for the date and time displays. */
-static TextLayer *weekday_text_layer, *date_text_layer, *time_text_layer;
+/** Number of glyph cells in the time display: HH:MM. */
+#define TIME_CELL_COUNT 5
+
+/** The time cell holding the colon. */
+#define TIME_COLON_CELL 2
+
+/** Index of the colon in the atlas, after the ten digits. */
+#define ATLAS_COLON_INDEX 10
+
+/** Child layers for the date displays. */
+static TextLayer *weekday_text_layer, *date_text_layer;
+
+/** 
+ * Text shown in the date layers. Pebble requires static vars for on-screen 
+ * text because they're used by the system later.
+ */
+static char weekday_text[16], date_text[16];
+
+/** 
+ * The time display: one small layer per glyph, so a new minute only redraws
+ * the digits that changed.
+ */
+static Layer *time_layer;
+static Layer *time_cells[TIME_CELL_COUNT];
+
+/** Character shown in each time cell ('0'-'9' or ':'), or 0 for none yet. */
+static char cell_chars[TIME_CELL_COUNT];
+
+/** The pre-rendered digits (see tools/digit_atlas.py), and a view of each. */
+static GBitmap *atlas;
+static GBitmap *glyphs[ATLAS_COLON_INDEX + 1];
+
+/**
+ * A Pebble LayerUpdateProc that copies one glyph of the time to the screen.
+ * The glyphs carry their own black background, so nothing needs clearing.
+ *
+ * @param layer The time cell that needs to be rendered.
+ * @param ctx The destination graphics context to draw into.
+ */
+static void time_cell_update_callback(Layer *layer, GContext *ctx) {
+  for (int i = 0; i < TIME_CELL_COUNT; i++) {
+    if (time_cells[i] != layer) continue;
+    char c = cell_chars[i];
+    GBitmap *glyph = NULL;
+    if (c >= '0' && c <= '9') {
+      glyph = glyphs[c - '0'];
+    } else if (c == ':') {
+      glyph = glyphs[ATLAS_COLON_INDEX];
+    }
+    if (glyph) {
+      graphics_draw_bitmap_in_rect(ctx, glyph, layer_get_bounds(layer));
+    }
+    return;
+  }
+}
+
+/**
+ * Shows a new time, marking only the cells whose glyph changed.
+ *
+ * @param text The time as HH:MM (exactly TIME_CELL_COUNT characters).
+ */
+static void set_time_text(const char *text) {
+  for (int i = 0; i < TIME_CELL_COUNT; i++) {
+    if (cell_chars[i] == text[i]) continue;
+    cell_chars[i] = text[i];
+    layer_mark_dirty(time_cells[i]);
+  }
+}
 
 // Docs are in the header file.
 void clock_layer_handle_minute_tick(struct tm *tick_time, 
     TimeUnits units_changed) {
-  // Pebble requires static vars for on-screen text because they're used by 
-  // the system later:
-  static char time_text[] = "00:00";
-  static char weekday_text[16] = "";
-  static char date_text[16] = "";
-
-  // Set the date components:
-  strftime(weekday_text, sizeof(weekday_text), "%A", tick_time);
-  strftime(date_text, sizeof(date_text), "%B %d", tick_time);
-  text_layer_set_text(weekday_text_layer, weekday_text);
-  text_layer_set_text(date_text_layer, date_text);
+  uint32_t started = perf_timer_start();
+  // Set the date components. They only change at midnight, so the layers
+  // are left alone (and not redrawn) the rest of the time:
+  char text[16];
+  strftime(text, sizeof(text), "%A", tick_time);
+  if (strcmp(text, weekday_text) != 0) {
+    strcpy(weekday_text, text);
+    text_layer_set_text(weekday_text_layer, weekday_text);
+  }
+  strftime(text, sizeof(text), "%B %d", tick_time);
+  if (strcmp(text, date_text) != 0) {
+    strcpy(date_text, text);
+    text_layer_set_text(date_text_layer, date_text);
+  }
 
   // Set the time component:
   char *time_format;
@@ -27,17 +99,20 @@ void clock_layer_handle_minute_tick(struct tm *tick_time,
   } else {
     time_format = "%I:%M";
   }
-  strftime(time_text, sizeof(time_text), time_format, tick_time);
-  // Drop the leading 0 for 12 hour clocks before 10:00:
-  //if (!clock_is_24h_style() && (time_text[0] == '0')) {
-  //  memmove(time_text, &time_text[1], sizeof(time_text) - 1);
-  //}
-  text_layer_set_text(time_text_layer, time_text);
+  // 12 hour clocks keep the leading 0 before 10:00 ("09:05"), so every time
+  // fills all TIME_CELL_COUNT cells of the layout.
+  if (strftime(text, sizeof(text), time_format, tick_time) == 
+      TIME_CELL_COUNT) {
+    set_time_text(text);
+  }
+  perf_timer_stop(PERF_TIMER_MINUTE_TICK, started);
 }
 
 // Docs are in the header file.
 void clock_layer_init(Layer *parent_layer) {
   GRect bounds = layer_get_bounds(parent_layer);
+  weekday_text[0] = '\0';
+  date_text[0] = '\0';
   
   // Layer that displays the day of the week:
   weekday_text_layer = text_layer_create((GRect) {
@@ -47,20 +122,37 @@ void clock_layer_init(Layer *parent_layer) {
   text_layer_set_text_color(weekday_text_layer, GColorWhite);
   text_layer_set_background_color(weekday_text_layer, GColorClear);
   text_layer_set_font(weekday_text_layer, 
-      fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16)));
+      resource_cache_get_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16));
   layer_add_child(parent_layer, text_layer_get_layer(weekday_text_layer));
 
-  // Layer that displays the time:
-  time_text_layer = text_layer_create((GRect) {
+  // Layer that displays the time, centered where a line of 53 px text would
+  // be. Its glyphs are cut from the atlas once; the font itself is never 
+  // loaded:
+  time_layer = layer_create((GRect) {
       .origin = { 0, 11 },
       .size = { bounds.size.w, 63 },
       });
-  text_layer_set_text_color(time_text_layer, GColorWhite);
-  text_layer_set_background_color(time_text_layer, GColorClear);
-  text_layer_set_text_alignment(time_text_layer, GTextAlignmentCenter);
-  text_layer_set_font(time_text_layer, fonts_load_custom_font(
-      resource_get_handle(RESOURCE_ID_FONT_FUTURA_CONDENSED_BOLD_53)));
-  layer_add_child(parent_layer, text_layer_get_layer(time_text_layer));
+  layer_add_child(parent_layer, time_layer);
+  atlas = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_CLOCK_DIGITS);
+  for (int i = 0; i <= ATLAS_COLON_INDEX; i++) {
+    glyphs[i] = gbitmap_create_as_sub_bitmap(atlas, GRect(
+        i * DIGIT_ATLAS_DIGIT_WIDTH, 0, 
+        i == ATLAS_COLON_INDEX ? DIGIT_ATLAS_COLON_WIDTH : 
+            DIGIT_ATLAS_DIGIT_WIDTH,
+        DIGIT_ATLAS_HEIGHT));
+  }
+  int16_t x = (bounds.size.w - 4 * DIGIT_ATLAS_DIGIT_WIDTH - 
+      DIGIT_ATLAS_COLON_WIDTH) / 2;
+  for (int i = 0; i < TIME_CELL_COUNT; i++) {
+    int16_t width = i == TIME_COLON_CELL ? DIGIT_ATLAS_COLON_WIDTH : 
+        DIGIT_ATLAS_DIGIT_WIDTH;
+    time_cells[i] = layer_create(GRect(x, DIGIT_ATLAS_TOP, width, 
+        DIGIT_ATLAS_HEIGHT));
+    layer_set_update_proc(time_cells[i], time_cell_update_callback);
+    layer_add_child(time_layer, time_cells[i]);
+    cell_chars[i] = 0;
+    x += width;
+  }
 
   // Layer that displays the month/day:
   date_text_layer = text_layer_create((GRect) {
@@ -71,7 +163,7 @@ void clock_layer_init(Layer *parent_layer) {
   text_layer_set_background_color(date_text_layer, GColorClear);
   text_layer_set_text_alignment(date_text_layer, GTextAlignmentRight);
   text_layer_set_font(date_text_layer, 
-      fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16)));
+      resource_cache_get_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16));
   layer_add_child(parent_layer, text_layer_get_layer(date_text_layer));
 }
 
@@ -79,5 +171,14 @@ void clock_layer_init(Layer *parent_layer) {
 void clock_layer_deinit(void) {
   text_layer_destroy(weekday_text_layer);
   text_layer_destroy(date_text_layer);
-  text_layer_destroy(time_text_layer);
+  for (int i = 0; i < TIME_CELL_COUNT; i++) {
+    layer_destroy(time_cells[i]);
+  }
+  layer_destroy(time_layer);
+  for (int i = 0; i <= ATLAS_COLON_INDEX; i++) {
+    gbitmap_destroy(glyphs[i]);
+  }
+  gbitmap_destroy(atlas);
+  resource_cache_release_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16);
+  resource_cache_release_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16);
 }
@@ -0,0 +1,20 @@
+// Generated from futura_condensed_bold-webfont.ttf (53 px) by tools/digit_atlas.py. Do not edit.
+
+#ifndef __DIGIT_ATLAS_H__
+#define __DIGIT_ATLAS_H__
+
+
+/** Width of each digit cell. Digits 0-9 are the first ten cells. */
+#define DIGIT_ATLAS_DIGIT_WIDTH 29
+
+/** Width of the colon cell, which follows the digits. */
+#define DIGIT_ATLAS_COLON_WIDTH 16
+
+/** Height of every cell. */
+#define DIGIT_ATLAS_HEIGHT 41
+
+/** Rows between the top of a line of text and the top of the cells. */
+#define DIGIT_ATLAS_TOP 2
+
+
+#endif  // __DIGIT_ATLAS_H__
@@ -0,0 +1,39 @@
+#include <pebble.h>
+#include "heap_stats.h"
+#include "logging.h"
+
+
+/** Names of the checkpoints, for the log. */
+static const char *checkpoint_names[HEAP_CHECKPOINT_COUNT] = {
+  "init",
+  "window load",
+  "first message",
+  "exit",
+};
+
+/** High-water marks since the app started. */
+static size_t max_used;
+static size_t min_free = SIZE_MAX;
+
+/** Which checkpoints have been logged already, as bit flags. */
+static uint8_t reached;
+
+/**
+ * Samples heap use, updating the high-water marks.
+ */
+static void sample(void) {
+  size_t bytes_used = heap_bytes_used();
+  size_t bytes_free = heap_bytes_free();
+  if (bytes_used > max_used) max_used = bytes_used;
+  if (bytes_free < min_free) min_free = bytes_free;
+}
+
+// Docs are in the header file.
+void heap_stats_checkpoint(HeapCheckpoint checkpoint) {
+  sample();
+  if (reached & (1 << checkpoint)) return;
+  reached |= 1 << checkpoint;
+  LOG_DEBUG("Heap at %s: %d used, %d free. Peak: %d used, %d free.",
+      checkpoint_names[checkpoint], (int) heap_bytes_used(),
+      (int) heap_bytes_free(), (int) max_used, (int) min_free);
+}
@@ -0,0 +1,39 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module tracks how much of the app heap we use, to know how much room
+ * is left for new features. The SDK only tells us current use, so we sample
+ * it at checkpoints where it changes most (see HeapCheckpoint), and keep the
+ * high-water marks: most heap used and least heap free. Each checkpoint is 
+ * logged at debug level the first time it's reached (build with 
+ * `--log-level=debug` to see them), along with the marks so far. Reaching it
+ * again only samples, so e.g. every message moves the marks.
+ *
+ * Static buffers don't show up here; the build reports those (see wscript).
+ */
+
+#ifndef __HEAP_STATS_H__
+#define __HEAP_STATS_H__
+
+#include <pebble.h>
+
+
+/** Points in the app's life where heap use is logged. */
+typedef enum {
+  HEAP_CHECKPOINT_INIT,           // App Message buffers opened
+  HEAP_CHECKPOINT_WINDOW_LOAD,    // layers created and fonts loaded
+  HEAP_CHECKPOINT_FIRST_MESSAGE,  // a message from the phone handled
+  HEAP_CHECKPOINT_EXIT,           // about to tear everything down
+  HEAP_CHECKPOINT_COUNT,
+} HeapCheckpoint;
+
+/**
+ * Samples heap use, updating the high-water marks, and logs it and the marks
+ * if this is the first time the checkpoint is reached.
+ *
+ * @param checkpoint Where the app is at.
+ */
+void heap_stats_checkpoint(HeapCheckpoint checkpoint);
+
+
+#endif  // __HEAP_STATS_H__
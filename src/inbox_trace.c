@@ -0,0 +1,174 @@
+#include <pebble.h>
+#include "inbox_trace.h"
+#include "persist_keys.h"
+#include "appkeys.auto.h"
+#include "logging.h"
+
+
+/** Version of the persisted layout. Bump on incompatible changes. */
+#define TRACE_VERSION 1
+
+/** What happened to a traced message. */
+typedef enum {
+  TRACE_EVENT_RECEIVED = 1,
+  TRACE_EVENT_DROPPED = 2,
+} TraceEvent;
+
+/** One traced message. 12 bytes, so a page fits in one persist key. */
+typedef struct {
+  uint32_t time;        // when it happened, seconds since the epoch
+  uint16_t time_ms;     // and milliseconds
+  uint8_t event;        // a TraceEvent
+  uint8_t tuple_count;  // received: number of tuples; dropped: 0
+  uint16_t detail;      // received: size in bytes; dropped: the reason
+  uint16_t first_key;   // received: key of the first tuple; dropped: 0
+} TraceRecord;
+
+/** Recorder state. Persisted as a whole under its own key. */
+typedef struct {
+  uint8_t version;
+  bool enabled;    // set by the phone
+  uint16_t next;   // slot the next record goes in
+  uint16_t count;  // number of records held
+} TraceHeader;
+
+static TraceHeader header;
+
+/** The page holding slot header.next, as persisted. */
+static TraceRecord page[INBOX_TRACE_PAGE_RECORDS];
+
+_Static_assert(sizeof(page) <= PERSIST_DATA_MAX_LENGTH,
+    "Trace pages must fit in one persist key");
+
+/**
+ * Reads a page of records from storage. Missing records are zeroed.
+ *
+ * @param index The page to read.
+ * @param records Output for the page's records.
+ */
+static void read_page(uint16_t index, TraceRecord *records) {
+  memset(records, 0, sizeof(page));
+  persist_read_data(TRACE_PAGE_PERSIST_KEY_BASE + index, records,
+      sizeof(page));
+}
+
+/**
+ * Logs a record in readable form. Records go to APP_LOG whatever the 
+ * LOG_LEVEL, since tracing was turned on to see them.
+ *
+ * @param index Index of the record, 0 being the oldest.
+ * @param record The record.
+ */
+static void log_record(uint16_t index, const TraceRecord *record) {
+  if (record->event == TRACE_EVENT_RECEIVED) {
+    APP_LOG(APP_LOG_LEVEL_INFO,
+        "Trace %d: %u.%03u received %d tuples, %d bytes, first key %d",
+        index, (unsigned) record->time, record->time_ms, record->tuple_count,
+        record->detail, record->first_key);
+  } else {
+    APP_LOG(APP_LOG_LEVEL_INFO, "Trace %d: %u.%03u dropped, reason %d",
+        index, (unsigned) record->time, record->time_ms, record->detail);
+  }
+}
+
+/**
+ * Logs every record kept, oldest first.
+ */
+static void log_records(void) {
+  APP_LOG(APP_LOG_LEVEL_INFO, "Inbox trace holds %d records.", header.count);
+  TraceRecord records[INBOX_TRACE_PAGE_RECORDS];
+  int loaded_page = -1;
+  uint16_t oldest = (header.next + INBOX_TRACE_CAPACITY - header.count) %
+      INBOX_TRACE_CAPACITY;
+  for (uint16_t i = 0; i < header.count; i++) {
+    uint16_t slot = (oldest + i) % INBOX_TRACE_CAPACITY;
+    int page_index = slot / INBOX_TRACE_PAGE_RECORDS;
+    if (page_index != loaded_page) {
+      read_page(page_index, records);
+      loaded_page = page_index;
+    }
+    log_record(i, &records[slot % INBOX_TRACE_PAGE_RECORDS]);
+  }
+}
+
+/**
+ * Saves the recorder state.
+ */
+static void save_header(void) {
+  int result = persist_write_data(TRACE_HEADER_PERSIST_KEY, &header,
+      sizeof(header));
+  if (result < 0) {
+    LOG_ERROR("Failed to save trace! Error: %d", result);
+  }
+}
+
+/**
+ * Appends a record to the ring and writes it through to storage.
+ *
+ * @param record The record to append. Its time is filled in here.
+ */
+static void append(TraceRecord record) {
+  time_t now;
+  record.time_ms = time_ms(&now, NULL);
+  record.time = (uint32_t) now;
+
+  uint16_t slot = header.next;
+  page[slot % INBOX_TRACE_PAGE_RECORDS] = record;
+  persist_write_data(TRACE_PAGE_PERSIST_KEY_BASE +
+      slot / INBOX_TRACE_PAGE_RECORDS, page, sizeof(page));
+
+  header.next = (slot + 1) % INBOX_TRACE_CAPACITY;
+  if (header.count < INBOX_TRACE_CAPACITY) header.count++;
+  save_header();
+
+  // Moving onto the next page, which is partly overwritten from here on:
+  if (header.next % INBOX_TRACE_PAGE_RECORDS == 0) {
+    read_page(header.next / INBOX_TRACE_PAGE_RECORDS, page);
+  }
+}
+
+// Docs are in the header file.
+void inbox_trace_init(void) {
+  header = (TraceHeader) { .version = TRACE_VERSION };
+  TraceHeader saved;
+  if (persist_read_data(TRACE_HEADER_PERSIST_KEY, &saved, sizeof(saved))
+        != (int) sizeof(saved) || saved.version != TRACE_VERSION ||
+      saved.count > INBOX_TRACE_CAPACITY ||
+      saved.next >= INBOX_TRACE_CAPACITY) {
+    return;
+  }
+  header = saved;
+  read_page(header.next / INBOX_TRACE_PAGE_RECORDS, page);
+  if (header.enabled) log_records();
+}
+
+// Docs are in the header file.
+void inbox_trace_record_received(const DictionaryIterator *iter) {
+  if (!header.enabled) return;
+  const Dictionary *dict = iter->dictionary;
+  append((TraceRecord) {
+    .event = TRACE_EVENT_RECEIVED,
+    .tuple_count = dict->count,
+    .detail = (const uint8_t *) iter->end - (const uint8_t *) dict,
+    .first_key = dict->count > 0 ? dict->head[0].key : 0,
+  });
+}
+
+// Docs are in the header file.
+void inbox_trace_record_dropped(AppMessageResult reason) {
+  if (!header.enabled) return;
+  append((TraceRecord) {
+    .event = TRACE_EVENT_DROPPED,
+    .detail = reason,
+  });
+}
+
+// Docs are in appkeys.auto.h (AppKeyHandler).
+void inbox_trace_handle_enable(const Tuple *tuple) {
+  bool enabled = tuple->value->int32 != 0;
+  if (enabled == header.enabled) return;
+  header.enabled = enabled;
+  save_header();
+  LOG_INFO("Inbox trace %s.",
+      enabled ? "started" : "stopped");
+}
@@ -0,0 +1,57 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module is an opt-in flight recorder for inbound App Messages. While
+ * the phone has it turned on (TRACE_KEY), every message received or dropped
+ * is appended to a ring of small binary records in persistent storage, so a
+ * misbehaving session (drops, bursts after a reconnect, doubled fetches) can
+ * be looked at after the fact. The records are logged at the next launch.
+ *
+ * The phone keeps the matching trace of what it sent, which host/replay.c
+ * can feed back through the watch code.
+ *
+ * Each record is written through to storage as it's made: tracing costs two
+ * persist writes per message, which is fine for a debugging aid but is why
+ * it's off by default.
+ */
+
+#ifndef __INBOX_TRACE_H__
+#define __INBOX_TRACE_H__
+
+#include <pebble.h>
+
+
+/** Number of records per persisted page. */
+#define INBOX_TRACE_PAGE_RECORDS 21
+
+/** Number of persisted pages. */
+#define INBOX_TRACE_PAGE_COUNT 4
+
+/** Number of records kept; the oldest are overwritten first. */
+#define INBOX_TRACE_CAPACITY (INBOX_TRACE_PAGE_RECORDS * INBOX_TRACE_PAGE_COUNT)
+
+/**
+ * Must be called before any other use of this module, and before App
+ * Messages start arriving. Restores the recorder's state and, if tracing is
+ * on, logs the records kept so far.
+ */
+void inbox_trace_init(void);
+
+/**
+ * Records a received message, if tracing is on. Call at the top of the
+ * AppMessageInboxReceived handler.
+ *
+ * @param iter The received message.
+ */
+void inbox_trace_record_received(const DictionaryIterator *iter);
+
+/**
+ * Records a dropped message, if tracing is on. Call from the
+ * AppMessageInboxDropped handler.
+ *
+ * @param reason Why the message was dropped.
+ */
+void inbox_trace_record_dropped(AppMessageResult reason);
+
+
+#endif  // __INBOX_TRACE_H__
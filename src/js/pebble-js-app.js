@@ -3,7 +3,8 @@
  * of user configuration and interacting with the New Relic API.
  *
  * Note: Pebble only allows one phone-side JS file, so everything needs to be 
- * thrown in here.
+ * thrown in here. The build prepends the generated APP_KEYS map (see 
+ * appkeys.json) to this file.
  */
 
 
@@ -13,10 +14,108 @@
 
 /** Base URL for the New Relic API. */
 NEWRELIC_API_URL = 'https://api.newrelic.com/v2';
-/** URL for our configuration page. */
-CONFIG_PAGE_URL = 'http://chrisregado.github.io/newrelic-watch/config/v1.0.2/config.html';
-/** Maximum amount of time (in ms) to wait for New Relic API responses. */
-AJAX_TIMEOUT = 30000;
+/** 
+ * URL for our configuration page. Each release of html/ is published under 
+ * its own version, so old phone JS keeps the page it was written for; bump
+ * the version here whenever html/ changes.
+ */
+CONFIG_PAGE_URL = 'http://chrisregado.github.io/newrelic-watch/config/v1.1.0/config.html';
+/** 
+ * Max time (in ms) to wait for each kind of New Relic API request. A poll's 
+ * requests run in parallel, so one slow endpoint only delays the poll by its
+ * own timeout, and doesn't cost us what the others returned.
+ */
+FETCH_TIMEOUTS = { app: 10000, violations: 10000, keyTransactions: 10000, 
+    series: 15000 };
+/** 
+ * Max time (in ms) a whole poll may take. Only a request that somehow never
+ * finishes should hit this; it's then treated as failed, so it can't hold up
+ * polling for good.
+ */
+FETCH_DEADLINE = 45000;
+/** 
+ * Size in bytes of the metric fields of an app table record. Must match 
+ * newrelic_protocol.h.
+ */
+METRICS_FIELDS_SIZE = 12;
+/** Version of the packed app table format. Must match newrelic_protocol.h. */
+TABLE_VERSION = 1;
+/** Max number of apps in an app table. Must match newrelic_protocol.h. */
+MAX_APPS = 12;
+/** 
+ * Max bytes (including the trailing \0) of an app name the watch will accept.
+ * Must match NEWRELIC_APP_NAME_SIZE in newrelic_protocol.h.
+ */
+APP_NAME_MAX_BYTES = 24;
+/** Max number of New Relic API requests we run at the same time. */
+FETCH_CONCURRENCY = 6;
+/** Version of the packed series format. Must match newrelic_protocol.h. */
+SERIES_VERSION = 1;
+/** 
+ * Max number of points in a series: the watch's screen width. Must match 
+ * NEWRELIC_SERIES_MAX_POINTS in newrelic_protocol.h.
+ */
+SERIES_MAX_POINTS = 144;
+/** 
+ * Size of the data in every transfer chunk but the last. Must match 
+ * transfer.h.
+ */
+TRANSFER_CHUNK_SIZE = 80;
+/** Max number of chunks in a transfer. Must match transfer.h. */
+TRANSFER_MAX_CHUNKS = 8;
+/** Max number of chunks of a transfer waiting for the watch's ack at once. */
+TRANSFER_WINDOW = 3;
+/** Delay (in ms) before resending a chunk the watch failed to ack. */
+TRANSFER_RETRY_MS = 1000;
+/** A transfer is abandoned after this many failed chunk sends. */
+TRANSFER_MAX_FAILURES = 10;
+/** Max number of sent App Messages kept in the stored trace. */
+TRACE_MAX_RECORDS = 200;
+/** 
+ * Log levels, most severe first. Messages less severe than the level chosen
+ * on the config page aren't logged.
+ */
+LOG_LEVELS = { error: 1, warning: 2, info: 3, debug: 4 };
+/** Version of the watch's stats snapshot format. Must match perf_stats.h. */
+PERF_STATS_VERSION = 1;
+/** Names of the watch's timed code paths, in PerfTimer order. */
+PERF_TIMER_NAMES = [
+  'message handler', 'display update', 'minute tick', 'draw metrics',
+  'draw sparkline', 'draw series',
+];
+/** Names of the watch's event counters, in PerfCounter order. */
+PERF_COUNTER_NAMES = ['received', 'dropped', 'send failed', 'retries'];
+/** Version of the packed overview format. Must match newrelic_protocol.h. */
+OVERVIEW_VERSION = 1;
+/** NewrelicOverviewFlag values. Must match newrelic_protocol.h. */
+OVERVIEW_HAS_VIOLATIONS = 1 << 0;
+OVERVIEW_MORE_VIOLATIONS = 1 << 1;
+OVERVIEW_HAS_HOSTS = 1 << 2;
+OVERVIEW_HAS_KEY_TRANSACTION = 1 << 3;
+/** Pebble TupleType values, for serializing App Messages ourselves. */
+TUPLE_BYTE_ARRAY = 0;
+TUPLE_CSTRING = 1;
+TUPLE_INT = 3;
+/**
+ * Metrics that can be charted as a time series: the NewrelicSeriesMetric we
+ * send, the New Relic metric and value to query, and the factor that turns 
+ * the value into the units the watch expects.
+ */
+SERIES_METRICS = {
+  response_time: { 
+    id: 0, name: 'HttpDispatcher', value: 'average_response_time', scale: 1000,
+  },
+  throughput: { 
+    id: 1, name: 'HttpDispatcher', value: 'requests_per_minute', scale: 1,
+  },
+};
+/** UPDATE_REQ_KEY value for a routine poll. */
+UPDATE_REQ_POLL = 1;
+/** 
+ * UPDATE_REQ_KEY value from a watch without fresh data (e.g. just launched),
+ * which needs the data sent even if it hasn't changed.
+ */
+UPDATE_REQ_FULL = 2;
 
 
 /***************************
@@ -32,19 +131,104 @@ AJAX_TIMEOUT = 30000;
  *        two components.
  * @this {Options}
  * @param {string} apiKey The user's New Relic API key.
- * @param {string} appId The New Relic app ID (digits only) of the New Relic
- *        app the user wants to monitor.
+ * @param {Array} appIds The New Relic app IDs (digits only) of the New Relic
+ *        apps the user wants to monitor, at most MAX_APPS. The first one is
+ *        the primary app, whose history the watch keeps.
  * @param {number} updateFreq The frequency (in minutes) with which we should
  *        fetch new New Relic data.
+ * @param {boolean} adaptive Whether to adapt the update frequency to how 
+ *        much the metrics are moving, instead of always using updateFreq.
+ * @param {number} minFreq Fastest adaptive update frequency (in minutes).
+ * @param {number} maxFreq Slowest adaptive update frequency (in minutes).
+ * @param {number} apdexFloor Adaptive mode polls at minFreq while apdex is 
+ *        below this.
+ * @param {number} errorRateCeiling Adaptive mode polls at minFreq while the
+ *        error rate (%) is above this.
+ * @param {number} cacheMaxAge Cached data up to this many minutes old is shown
+ *        on the watch while fresh data is fetched.
+ * @param {boolean} seriesMode Whether to also fetch a time series of one 
+ *        metric of the first app for the watch to chart.
+ * @param {string} seriesMetric The metric to chart (see SERIES_METRICS).
+ * @param {number} seriesWindow The time window to chart, in minutes.
+ * @param {boolean} traceMode Whether to record App Message traffic on the 
+ *        phone and watch, for debugging.
+ * @param {string} logLevel The least severe messages to log (see 
+ *        LOG_LEVELS).
  */
-function Options(apiKey, appId, updateFreq) {
+function Options(apiKey, appIds, updateFreq, adaptive, minFreq, maxFreq, 
+    apdexFloor, errorRateCeiling, cacheMaxAge, seriesMode, seriesMetric, 
+    seriesWindow, traceMode, logLevel) {
   this.apiKey = apiKey;
-  this.appId = appId;
+  this.appIds = appIds || [];
   this.updateFreq = updateFreq || Options.DEFAULT_UPDATE_FREQ;
+  this.adaptive = !!adaptive;
+  this.minFreq = minFreq || Options.DEFAULT_MIN_FREQ;
+  this.maxFreq = maxFreq || Options.DEFAULT_MAX_FREQ;
+  this.apdexFloor = Options.valueOr(apdexFloor, Options.DEFAULT_APDEX_FLOOR);
+  this.errorRateCeiling = Options.valueOr(errorRateCeiling, 
+      Options.DEFAULT_ERROR_RATE_CEILING);
+  this.cacheMaxAge = cacheMaxAge || Options.DEFAULT_CACHE_MAX_AGE;
+  this.seriesMode = !!seriesMode;
+  this.seriesMetric = seriesMetric || Options.DEFAULT_SERIES_METRIC;
+  this.seriesWindow = seriesWindow || Options.DEFAULT_SERIES_WINDOW;
+  this.traceMode = !!traceMode;
+  this.logLevel = logLevel || Options.DEFAULT_LOG_LEVEL;
 }
 
 /** Default value for the update frequency option in case the user skips it. */
 Options.DEFAULT_UPDATE_FREQ = 5;
+/** Defaults for the adaptive update frequency options. */
+Options.DEFAULT_MIN_FREQ = 1;
+Options.DEFAULT_MAX_FREQ = 30;
+Options.DEFAULT_APDEX_FLOOR = 0.85;
+Options.DEFAULT_ERROR_RATE_CEILING = 1;
+/** 
+ * Longest update frequency we send the watch (in minutes): a day. The watch
+ * clamps to the same limit (NEWRELIC_MAX_UPDATE_INTERVAL_MINS).
+ */
+Options.MAX_FREQ = 1440;
+/** Default value for the cache max age option. */
+Options.DEFAULT_CACHE_MAX_AGE = 60;
+/** Defaults for the time series options. */
+Options.DEFAULT_SERIES_METRIC = 'response_time';
+Options.DEFAULT_SERIES_WINDOW = 60;
+/** Default log level: problems only. */
+Options.DEFAULT_LOG_LEVEL = 'warning';
+
+/**
+ * Picks an option's value, or its default if it's missing. Unlike ||, keeps
+ * a 0, for options where 0 is a legal value.
+ *
+ * @param value The option's value.
+ * @param fallback The option's default.
+ * @return value, or fallback if value is undefined or null.
+ */
+Options.valueOr = function(value, fallback) {
+  return (value === undefined || value === null) ? fallback : value;
+}
+
+/**
+ * Parses a positive whole number of minutes.
+ *
+ * @param value The value to parse.
+ * @param {number} fallback Returned if value isn't a valid number of minutes.
+ * @return {number} The parsed value.
+ */
+Options.parseMinutes = function(value, fallback) {
+  var parsed = parseInt(value);
+  return (parsed && parsed >= 1) ? parsed : fallback;
+}
+
+/**
+ * Parses an update frequency: a number of minutes up to MAX_FREQ.
+ *
+ * @param value The value to parse.
+ * @param {number} fallback Returned if value isn't a valid number of minutes.
+ * @return {number} The parsed value.
+ */
+Options.parseFreq = function(value, fallback) {
+  return Math.min(Options.parseMinutes(value, fallback), Options.MAX_FREQ);
+}
 
 /**
  * Cleans this Options object's properties.
@@ -57,17 +241,43 @@ Options.prototype.sanitize = function() {
     this.apiKey = this.apiKey.replace(/[^a-z0-9]/gi, '');
   }
 
-  // Clean appId:
-  if (this.appId) {
-    this.appId = this.appId.replace(/[^0-9]/g, '');
+  // Clean appIds:
+  var appIds = [];
+  (this.appIds || []).forEach(function(appId) {
+    appId = String(appId).replace(/[^0-9]/g, '');
+    if (appId && appIds.indexOf(appId) < 0) appIds.push(appId);
+  });
+  this.appIds = appIds.slice(0, MAX_APPS);
+
+  // Clean frequencies:
+  this.updateFreq = Options.parseFreq(this.updateFreq, 
+      Options.DEFAULT_UPDATE_FREQ);
+  this.minFreq = Options.parseFreq(this.minFreq, Options.DEFAULT_MIN_FREQ);
+  this.maxFreq = Math.max(this.minFreq,
+      Options.parseFreq(this.maxFreq, Options.DEFAULT_MAX_FREQ));
+  this.cacheMaxAge = Options.parseMinutes(this.cacheMaxAge, 
+      Options.DEFAULT_CACHE_MAX_AGE);
+  this.seriesWindow = Options.parseMinutes(this.seriesWindow, 
+      Options.DEFAULT_SERIES_WINDOW);
+
+  // Clean time series settings:
+  this.seriesMode = !!this.seriesMode;
+  if (!(this.seriesMetric in SERIES_METRICS)) {
+    this.seriesMetric = Options.DEFAULT_SERIES_METRIC;
   }
 
-  // Clean updateFreq:
-  var parsedUpdateFreq = parseInt(this.updateFreq);
-  if (parsedUpdateFreq && parsedUpdateFreq >= 1) {
-    this.updateFreq = parsedUpdateFreq;
-  } else {
-    this.updateFreq = DEFAULT_UPDATE_FREQ;
+  this.traceMode = !!this.traceMode;
+  if (!(this.logLevel in LOG_LEVELS)) {
+    this.logLevel = Options.DEFAULT_LOG_LEVEL;
+  }
+
+  // Clean alert bands:
+  this.adaptive = !!this.adaptive;
+  this.apdexFloor = parseFloat(this.apdexFloor);
+  if (isNaN(this.apdexFloor)) this.apdexFloor = Options.DEFAULT_APDEX_FLOOR;
+  this.errorRateCeiling = parseFloat(this.errorRateCeiling);
+  if (isNaN(this.errorRateCeiling)) {
+    this.errorRateCeiling = Options.DEFAULT_ERROR_RATE_CEILING;
   }
 }
 
@@ -79,7 +289,8 @@ Options.prototype.sanitize = function() {
 Options.prototype.save = function() {
   this.sanitize();
   window.localStorage.setItem('options', JSON.stringify(this));
-  console.log('Saved options: ' + JSON.stringify(this));
+  var options = this;
+  log.debug(function() { return 'Saved options: ' + JSON.stringify(options); });
 }
 
 /**
@@ -106,36 +317,890 @@ Options.getSavedOptions = function() {
 Options.fromObject = function(obj) {
   var options = new Options(
     obj.apiKey,
-    obj.appId,
-    obj.updateFreq
+    // Options saved before multi-app support have a single appId:
+    obj.appIds || (obj.appId ? [obj.appId] : []),
+    obj.updateFreq,
+    obj.adaptive,
+    obj.minFreq,
+    obj.maxFreq,
+    obj.apdexFloor,
+    obj.errorRateCeiling,
+    obj.cacheMaxAge,
+    obj.seriesMode,
+    obj.seriesMetric,
+    obj.seriesWindow,
+    obj.traceMode,
+    obj.logLevel
   );
   return options;
 }
 
 
+/**********
+ * Logging:
+ **********/
+
+/**
+ * Creates an instance of Logger.
+ *
+ * @class Logs messages at or above the log level saved in Options. The level
+ *        is cached, since reading Options means parsing localStorage; call 
+ *        reload when it changes. Messages that are costly to build (big 
+ *        JSON dumps, response bodies) can be passed as a function returning 
+ *        the message, which is only called if the message gets logged.
+ * @this {Logger}
+ */
+function Logger() {
+  this.level = null;  // numeric level (see LOG_LEVELS); loaded lazily
+}
+
+/**
+ * Re-reads the log level from the saved Options.
+ *
+ * @this {Logger}
+ */
+Logger.prototype.reload = function() {
+  this.level = LOG_LEVELS[Options.getSavedOptions().logLevel];
+}
+
+/**
+ * Logs a message if its level is enabled.
+ *
+ * @this {Logger}
+ * @param {string} level The message's level (a key of LOG_LEVELS).
+ * @param {string|function(): string} message The message, or a function
+ *        that builds it.
+ */
+Logger.prototype.log = function(level, message) {
+  if (this.level === null) this.reload();
+  if (LOG_LEVELS[level] > this.level) return;
+  console.log(typeof message == 'function' ? message() : message);
+}
+
+/** Shorthands for Logger.prototype.log at each level. */
+Logger.prototype.error = function(message) { this.log('error', message); }
+Logger.prototype.warning = function(message) { this.log('warning', message); }
+Logger.prototype.info = function(message) { this.log('info', message); }
+Logger.prototype.debug = function(message) { this.log('debug', message); }
+
+/** The logger for everything but traces, which are logged when turned on. */
+var log = new Logger();
+
+
+/*******************
+ * Polling cadence:
+ *******************/
+
+/**
+ * Creates an instance of PollCadence.
+ *
+ * @class Decides how often the watch should poll for new data. With adaptive 
+ *        mode off, that's just the configured update frequency. In adaptive 
+ *        mode, we poll at the minimum interval while metrics are moving or 
+ *        outside the user's alert bands. While they're flat, and after failed
+ *        fetches, the interval doubles up to the maximum.
+ * @this {PollCadence}
+ */
+function PollCadence() {
+  this.freq = null;         // current interval in minutes; null if unset
+  this.lastMetrics = null;  // metrics of each app from the last fetch
+}
+
+/** 
+ * Relative change in response time or throughput between two fetches that
+ * counts as the metrics moving.
+ */
+PollCadence.CHANGE_RATIO = 0.2;
+/** Absolute apdex change between two fetches that counts as moving. */
+PollCadence.APDEX_CHANGE = 0.05;
+/** Absolute error rate (%) change between two fetches that counts as moving. */
+PollCadence.ERROR_RATE_CHANGE = 0.5;
+
+/**
+ * Returns the poll interval the watch should currently use.
+ *
+ * @this {PollCadence}
+ * @return {number} The interval in minutes.
+ */
+PollCadence.prototype.getFreq = function() {
+  var options = Options.getSavedOptions();
+  if (!options.adaptive) return options.updateFreq;
+  if (!this.freq) this.freq = options.minFreq;
+  return Math.min(Math.max(this.freq, options.minFreq), options.maxFreq);
+}
+
+/**
+ * Checks whether any app's metrics changed noticeably since the last fetch.
+ *
+ * @this {PollCadence}
+ * @param {Array} metricsList Metrics of each app, as passed to 
+ *        encodeMetricFields.
+ * @return {boolean} True if the metrics are moving.
+ */
+PollCadence.prototype.isMoving = function(metricsList) {
+  var lastList = this.lastMetrics;
+  if (!lastList || lastList.length != metricsList.length) return true;
+  for (var i = 0; i < metricsList.length; i++) {
+    if (PollCadence.hasMoved(lastList[i], metricsList[i])) return true;
+  }
+  return false;
+}
+
+/**
+ * Checks whether one app's metrics changed noticeably between two fetches.
+ *
+ * @param {Object} last Metrics from the earlier fetch.
+ * @param {Object} metrics Metrics from the later fetch.
+ * @return {boolean} True if the metrics moved.
+ */
+PollCadence.hasMoved = function(last, metrics) {
+  var relativeChange = function(from, to) {
+    if (!from) return to ? Infinity : 0;
+    return Math.abs(to - from) / from;
+  };
+  return relativeChange(last.responseTime, metrics.responseTime) > 
+          PollCadence.CHANGE_RATIO ||
+      relativeChange(last.throughput, metrics.throughput) > 
+          PollCadence.CHANGE_RATIO ||
+      Math.abs(metrics.apdexScore - last.apdexScore) >= 
+          PollCadence.APDEX_CHANGE ||
+      Math.abs(metrics.errorRate - last.errorRate) >= 
+          PollCadence.ERROR_RATE_CHANGE;
+}
+
+/**
+ * Checks whether one app's metrics are outside the user's alert bands. An 
+ * app with no traffic (0 rpm, or not reporting) has no apdex and no errors to
+ * speak of, so it's never out of band; it mustn't keep quiet nights polling 
+ * at the fastest rate.
+ *
+ * @param {Object} metrics The app's metrics, as passed to encodeMetricFields.
+ *        apdexScore is null at 0 rpm.
+ * @param {Options} options The currently saved Options.
+ * @return {boolean} True if the metrics are out of band.
+ */
+PollCadence.isOutOfBand = function(metrics, options) {
+  if (metrics.apdexScore !== null && metrics.apdexScore !== undefined &&
+      metrics.apdexScore < options.apdexFloor) {
+    return true;
+  }
+  return !!metrics.throughput && 
+      (metrics.errorRate || 0) > options.errorRateCeiling;
+}
+
+/**
+ * Updates the cadence after a successful fetch, and tells the watch if the 
+ * interval changed. Any one app out of band or moving keeps polling fast.
+ *
+ * @this {PollCadence}
+ * @param {Array} metricsList Metrics of each app, as passed to 
+ *        encodeMetricFields.
+ */
+PollCadence.prototype.onSuccess = function(metricsList) {
+  var options = Options.getSavedOptions();
+  var oldFreq = this.getFreq();
+  var outOfBand = metricsList.some(function(metrics) {
+    return PollCadence.isOutOfBand(metrics, options);
+  });
+  if (outOfBand || this.isMoving(metricsList)) {
+    this.freq = options.minFreq;
+  } else {
+    this.freq = oldFreq * 2;
+  }
+  this.lastMetrics = metricsList;
+  if (this.getFreq() != oldFreq) transmitCurrentUpdateFreq();
+}
+
+/**
+ * Backs the cadence off exponentially after a failed fetch, and tells the 
+ * watch if the interval changed.
+ *
+ * @this {PollCadence}
+ */
+PollCadence.prototype.onFailure = function() {
+  var oldFreq = this.getFreq();
+  this.freq = oldFreq * 2;
+  if (this.getFreq() != oldFreq) transmitCurrentUpdateFreq();
+}
+
+/** The cadence for this session. */
+var pollCadence = new PollCadence();
+
+
+/******************
+ * Metrics encoding:
+ ******************/
+
+/**
+ * Packs New Relic metrics into the metric fields of an app table record, as
+ * understood by the watch (see newrelic_protocol.h). Pebble has no floats, 
+ * so every value is sent as a little-endian scaled integer.
+ *
+ * @param {Object} metrics Raw metrics with float attributes apdexScore, 
+ *        errorRate (%), responseTime (ms) and throughput (rpm).
+ * @return {Array} The packed fields as an array of byte values.
+ */
+function encodeMetricFields(metrics) {
+  var bytes = [];
+  packUint(bytes, metrics.apdexScore * 100, 2);
+  packUint(bytes, metrics.errorRate * 100, 2);
+  packUint(bytes, metrics.responseTime * 1000, 4);
+  packUint(bytes, metrics.throughput, 4);
+  return bytes;
+}
+
+/**
+ * Appends a little-endian unsigned integer to a packed payload. Values are 
+ * rounded and clamped to what fits; missing values become 0.
+ *
+ * @param {Array} bytes The payload to append to.
+ * @param {number} value The value to pack.
+ * @param {number} numBytes Size of the packed integer.
+ */
+function packUint(bytes, value, numBytes) {
+  var max = Math.pow(2, numBytes * 8) - 1;
+  value = Math.min(Math.max(Math.round(value) || 0, 0), max);
+  for (var i = 0; i < numBytes; i++) {
+    bytes.push(value % 256);
+    value = Math.floor(value / 256);
+  }
+}
+
+/**
+ * Unpacks metric fields as produced by encodeMetricFields.
+ *
+ * @param {Array} bytes The packed bytes.
+ * @param {number} offset Where the fields start in bytes.
+ * @return {Object} The metrics (as in encodeMetricFields).
+ */
+function decodeMetricFields(bytes, offset) {
+  var readUint = function(numBytes) {
+    var value = 0;
+    for (var i = numBytes - 1; i >= 0; i--) {
+      value = value * 256 + bytes[offset + i];
+    }
+    offset += numBytes;
+    return value;
+  };
+  return {
+    apdexScore: readUint(2) / 100,
+    errorRate: readUint(2) / 100,
+    responseTime: readUint(4) / 1000,
+    throughput: readUint(4),
+  };
+}
+
+/**
+ * Encodes a string as an array of UTF-8 byte values.
+ *
+ * @param {string} str The string to encode.
+ * @return {Array} The encoded bytes, without a \0 terminator.
+ */
+function utf8Bytes(str) {
+  var encoded = unescape(encodeURIComponent(str));
+  var bytes = [];
+  for (var i = 0; i < encoded.length; i++) bytes.push(encoded.charCodeAt(i));
+  return bytes;
+}
+
+/**
+ * Packs several apps into the binary app table understood by the watch (see
+ * newrelic_protocol.h), so they can all be sent in a single App Message.
+ *
+ * @param {Array} apps Objects with attributes name and metrics (as passed to
+ *        encodeMetricFields). Only the first MAX_APPS are packed.
+ * @return {Array} The packed table as an array of byte values.
+ */
+function encodeAppTable(apps) {
+  apps = apps.slice(0, MAX_APPS);
+  var bytes = [TABLE_VERSION, apps.length];
+  apps.forEach(function(app) {
+    var name = utf8Bytes(truncateUtf8(app.name || '', APP_NAME_MAX_BYTES));
+    bytes = bytes.concat([name.length], name, encodeMetricFields(app.metrics));
+  });
+  return bytes;
+}
+
+/**
+ * Unpacks a binary app table. The inverse of encodeAppTable, mostly useful 
+ * for logging what we sent to the watch.
+ *
+ * @param {Array} bytes A packed table as produced by encodeAppTable.
+ * @return {Array} Objects with attributes name and metrics, or null if the 
+ *         table is malformed or of an unknown version.
+ */
+function decodeAppTable(bytes) {
+  if (!bytes || bytes.length < 2 || bytes[0] != TABLE_VERSION) return null;
+  var apps = [];
+  var offset = 2;
+  for (var i = 0; i < bytes[1]; i++) {
+    var nameLength = bytes[offset];
+    if (offset + 1 + nameLength + METRICS_FIELDS_SIZE > bytes.length) {
+      return null;
+    }
+    var name = String.fromCharCode.apply(null, 
+        bytes.slice(offset + 1, offset + 1 + nameLength));
+    offset += 1 + nameLength;
+    apps.push({
+      name: decodeURIComponent(escape(name)),
+      metrics: decodeMetricFields(bytes, offset),
+    });
+    offset += METRICS_FIELDS_SIZE;
+  }
+  return apps;
+}
+
+/**
+ * Reduces a series to at most the given number of points with the 
+ * largest-triangle-three-buckets algorithm. Unlike plain averaging, it keeps
+ * the points that shape the line, so short spikes survive.
+ *
+ * @param {Array} data Points with attributes x and y, in order of x.
+ * @param {number} threshold Max number of points to keep (at least 3).
+ * @return {Array} The kept points, in order. Always includes the first and 
+ *         last point.
+ */
+function downsampleLttb(data, threshold) {
+  if (data.length <= threshold || threshold < 3) return data.slice();
+  var sampled = [data[0]];
+  var bucketSize = (data.length - 2) / (threshold - 2);
+  var previous = data[0];
+  for (var i = 0; i < threshold - 2; i++) {
+    // The third corner of the triangle is the average of the next bucket:
+    var nextStart = Math.floor((i + 1) * bucketSize) + 1;
+    var nextEnd = Math.min(Math.floor((i + 2) * bucketSize) + 1, data.length);
+    var avgX = 0;
+    var avgY = 0;
+    for (var j = nextStart; j < nextEnd; j++) {
+      avgX += data[j].x;
+      avgY += data[j].y;
+    }
+    avgX /= nextEnd - nextStart;
+    avgY /= nextEnd - nextStart;
+
+    // Keep the point in this bucket that makes the largest triangle:
+    var maxArea = -1;
+    var kept = null;
+    for (j = Math.floor(i * bucketSize) + 1; j < nextStart; j++) {
+      var area = Math.abs((previous.x - avgX) * (data[j].y - previous.y) - 
+          (previous.x - data[j].x) * (avgY - previous.y));
+      if (area > maxArea) {
+        maxArea = area;
+        kept = data[j];
+      }
+    }
+    sampled.push(kept);
+    previous = kept;
+  }
+  sampled.push(data[data.length - 1]);
+  return sampled;
+}
+
+/**
+ * Packs a time series into the binary format understood by the watch (see
+ * newrelic_protocol.h), quantizing each point to a byte.
+ *
+ * @param {number} metricId The charted metric (see SERIES_METRICS).
+ * @param {number} windowMins The time window the series covers.
+ * @param {Array} values Point values in the units the watch expects, oldest
+ *        first. At most SERIES_MAX_POINTS; empty clears the watch's chart.
+ * @return {Array} The packed series as an array of byte values.
+ */
+function encodeSeries(metricId, windowMins, values) {
+  var min = values.length ? Math.min.apply(null, values) : 0;
+  var max = values.length ? Math.max.apply(null, values) : 0;
+  var bytes = [SERIES_VERSION, metricId];
+  packUint(bytes, min, 4);
+  packUint(bytes, max, 4);
+  packUint(bytes, windowMins, 2);
+  bytes.push(values.length);
+  values.forEach(function(value) {
+    // A flat series sits in the middle of the chart:
+    bytes.push(max > min ? Math.round((value - min) * 255 / (max - min)) : 128);
+  });
+  return bytes;
+}
+
+/**
+ * Packs the account overview into the binary format understood by the watch
+ * (see newrelic_protocol.h). Parts we never managed to fetch are flagged as
+ * missing, so the watch leaves them out.
+ *
+ * @param {Object} overview Attributes violations (number of open alert 
+ *        violations, or null), moreViolations (whether there are more than
+ *        counted) and keyTransaction (the slowest key transaction, with 
+ *        attributes name and responseTime in ms; or null).
+ * @param {Array} apps App cache entries (as in FetchCoordinator.loadCache). 
+ *        Their hosts are summed; apps whose host count is unknown are left 
+ *        out.
+ * @return {Array} The packed overview as an array of byte values.
+ */
+function encodeOverview(overview, apps) {
+  var flags = 0;
+  var hosts = 0;
+  apps.forEach(function(app) {
+    if (typeof app.hosts != 'number') return;
+    hosts += app.hosts;
+    flags |= OVERVIEW_HAS_HOSTS;
+  });
+  if (overview.violations !== null) {
+    flags |= OVERVIEW_HAS_VIOLATIONS;
+    if (overview.moreViolations) flags |= OVERVIEW_MORE_VIOLATIONS;
+  }
+  var transaction = overview.keyTransaction;
+  if (transaction) flags |= OVERVIEW_HAS_KEY_TRANSACTION;
+  var bytes = [OVERVIEW_VERSION, flags];
+  packUint(bytes, overview.violations, 2);
+  packUint(bytes, hosts, 2);
+  packUint(bytes, transaction ? transaction.responseTime * 1000 : 0, 4);
+  var name = utf8Bytes(transaction ? 
+      truncateUtf8(transaction.name || '', APP_NAME_MAX_BYTES) : '');
+  return bytes.concat([name.length], name);
+}
+
+/**
+ * Shortens a string so that its UTF-8 encoding (plus a trailing \0) fits in 
+ * the given number of bytes, without splitting a multi-byte character. The 
+ * watch sizes its inbox for short names, so anything longer would be dropped.
+ *
+ * @param {string} str The string to shorten.
+ * @param {number} maxBytes Max encoded size, including the \0 terminator.
+ * @return {string} The (possibly) shortened string.
+ */
+function truncateUtf8(str, maxBytes) {
+  var bytes = 1;  // \0
+  for (var i = 0; i < str.length; i++) {
+    var code = str.charCodeAt(i);
+    var charBytes = code < 0x80 ? 1 : code < 0x800 ? 2 : 
+        (code >= 0xD800 && code < 0xDC00) ? 4 : 3;
+    if (bytes + charBytes > maxBytes) return str.substring(0, i);
+    bytes += charBytes;
+    if (charBytes == 4) i++;  // skip the low surrogate
+  }
+  return str;
+}
+
+/**
+ * Unpacks a stats snapshot from the watch (PERF_STATS_KEY), as defined in 
+ * perf_stats.h. Timers and counters the watch has but we don't know the
+ * names of are named by position.
+ *
+ * @param {Array} bytes The packed snapshot.
+ * @return {Object} The stats: uptimeSecs, timers (each with name, calls, 
+ *         totalMs, maxMs and buckets, an array of call counts) and counters
+ *         (each with name and value), or null if the snapshot is malformed
+ *         or of an unknown version.
+ */
+function decodePerfStats(bytes) {
+  if (!bytes || bytes.length < 8 || bytes[0] != PERF_STATS_VERSION) {
+    return null;
+  }
+  var timerCount = bytes[1];
+  var bucketCount = bytes[2];
+  var counterCount = bytes[3];
+  if (bytes.length < 8 + timerCount * (10 + 2 * bucketCount) + 
+      counterCount * 4) {
+    return null;
+  }
+  var offset = 4;
+  var readUint = function(numBytes) {
+    var value = 0;
+    for (var i = numBytes - 1; i >= 0; i--) {
+      value = value * 256 + bytes[offset + i];
+    }
+    offset += numBytes;
+    return value;
+  };
+  var stats = { uptimeSecs: readUint(4), timers: [], counters: [] };
+  for (var t = 0; t < timerCount; t++) {
+    var timer = {
+      name: PERF_TIMER_NAMES[t] || 'timer ' + t,
+      calls: readUint(4),
+      totalMs: readUint(4),
+      maxMs: readUint(2),
+      buckets: [],
+    };
+    for (var b = 0; b < bucketCount; b++) timer.buckets.push(readUint(2));
+    stats.timers.push(timer);
+  }
+  for (var c = 0; c < counterCount; c++) {
+    stats.counters.push({
+      name: PERF_COUNTER_NAMES[c] || 'counter ' + c,
+      value: readUint(4),
+    });
+  }
+  return stats;
+}
+
+/**
+ * Formats decoded watch stats for reading, one line per timer plus one for
+ * the counters. Histograms are shown as "<upper bound in ms>:<calls>" for
+ * each non-empty bucket, with the open-ended last bucket shown as ">=".
+ *
+ * @param {Object} stats Stats as returned by decodePerfStats.
+ * @return {Array} Lines of text.
+ */
+function formatPerfStats(stats) {
+  var lines = ['Watch stats over ' + Math.round(stats.uptimeSecs / 60) + 
+      ' mins:'];
+  stats.timers.forEach(function(timer) {
+    var avg = timer.calls ? (timer.totalMs / timer.calls).toFixed(1) : '-';
+    var histogram = [];
+    timer.buckets.forEach(function(count, b) {
+      if (!count) return;
+      var last = b == timer.buckets.length - 1;
+      var label = last ? '>=' + (b ? 1 << (b - 1) : 0) : '<' + (1 << b);
+      histogram.push(label + ':' + count);
+    });
+    lines.push(timer.name + ': ' + timer.calls + ' calls, avg ' + avg + 
+        ' ms, max ' + timer.maxMs + ' ms [' + histogram.join(' ') + ']');
+  });
+  lines.push(stats.counters.map(function(counter) {
+    return counter.name + ' ' + counter.value;
+  }).join(', '));
+  return lines;
+}
+
+
 /*********************
  * Data communication:
  *********************/
 
 /**
- * Inform the watch how often it should update New Relic data.
+ * Builds an App Message dictionary from key names, so that we always send the
+ * numeric keys from the generated schema rather than relying on appinfo.json.
+ *
+ * @param {Object} fields Message values keyed by App Message key name.
+ * @return {Object} The same values keyed by numeric App Message key.
+ */
+function buildAppMessage(fields) {
+  var message = {};
+  for (var name in fields) {
+    if (!(name in APP_KEYS)) {
+      throw new Error('Unknown App Message key: ' + name);
+    }
+    message[APP_KEYS[name]] = fields[name];
+  }
+  return message;
+}
+
+/**
+ * Looks up a value in a received App Message payload by key name. Depending 
+ * on the Pebble app version, payloads are keyed by name, number or both.
+ *
+ * @param {Object} payload The payload of an appmessage event.
+ * @param {string} name The App Message key name.
+ * @return The value, or undefined if the key is absent.
+ */
+function getAppMessageValue(payload, name) {
+  var value = payload[APP_KEYS[name]];
+  return value !== undefined ? value : payload[name];
+}
+
+/**
+ * Serializes an App Message dictionary the way the watch lays it out in 
+ * memory, so it can be reassembled there from chunks (see transfer.h).
+ *
+ * @param {Object} fields Message values keyed by App Message key name. 
+ *        Numbers are sent as int32, strings as cstrings and arrays as bytes.
+ * @return {Array} The serialized dictionary as an array of byte values.
+ */
+function serializeAppMessage(fields) {
+  var bytes = [0];  // tuple count
+  for (var name in fields) {
+    if (!(name in APP_KEYS)) {
+      throw new Error('Unknown App Message key: ' + name);
+    }
+    var value = fields[name];
+    var type = TUPLE_BYTE_ARRAY;
+    var data = value;
+    if (typeof value == 'number') {
+      type = TUPLE_INT;
+      data = [];
+      packUint(data, value >>> 0, 4);
+    } else if (typeof value == 'string') {
+      type = TUPLE_CSTRING;
+      data = utf8Bytes(value).concat([0]);
+    }
+    packUint(bytes, APP_KEYS[name], 4);
+    bytes.push(type);
+    packUint(bytes, data.length, 2);
+    bytes = bytes.concat(data);
+    bytes[0]++;
+  }
+  return bytes;
+}
+
+/**
+ * Sends an App Message to the watch, recording it if tracing is on. All 
+ * messages to the watch go through here.
+ *
+ * @param {Object} fields Message values keyed by App Message key name, as in
+ *        serializeAppMessage.
+ * @param {function(Object)} onAck Called when the watch acks the message.
+ * @param {function(Object)} onNack Called when the watch fails to ack it.
+ */
+function sendAppMessage(fields, onAck, onNack) {
+  trafficRecorder.record(fields);
+  Pebble.sendAppMessage(buildAppMessage(fields), onAck, onNack);
+}
+
+/**
+ * Creates an instance of TrafficRecorder.
+ *
+ * @class Records the App Messages we send the watch while the user has 
+ *        tracing turned on, so a misbehaving session can be replayed offline
+ *        through the watch code (see host/replay.c). Each message is logged 
+ *        as it's sent, as a line of the form "TRACE <sequence number> 
+ *        <ms since the epoch> <serialized dictionary in hex>". The last 
+ *        TRACE_MAX_RECORDS lines are also kept in localStorage and logged 
+ *        again at startup, for sessions nobody was watching the logs of. 
+ *        Sequence numbers keep counting across sessions, so the replay can 
+ *        tell those repeats apart. The watch keeps its own record of what 
+ *        arrived (see inbox_trace.h).
+ * @this {TrafficRecorder}
+ */
+function TrafficRecorder() {
+  this.records = null;  // stored trace lines, oldest first; loaded lazily
+}
+
+/**
+ * Returns the stored trace lines, loading them if needed.
+ *
+ * @this {TrafficRecorder}
+ * @return {Array} The stored lines, oldest first.
+ */
+TrafficRecorder.prototype.load = function() {
+  if (!this.records) {
+    try {
+      this.records = JSON.parse(window.localStorage.getItem('trace')) || [];
+    } catch (err) {
+      this.records = [];
+    }
+  }
+  return this.records;
+}
+
+/**
+ * Records a message about to be sent, if tracing is on.
+ *
+ * @this {TrafficRecorder}
+ * @param {Object} fields The message, as passed to sendAppMessage.
+ */
+TrafficRecorder.prototype.record = function(fields) {
+  if (!Options.getSavedOptions().traceMode) return;
+  var hex = serializeAppMessage(fields).map(function(byte) {
+    return (byte < 16 ? '0' : '') + byte.toString(16);
+  }).join('');
+  var seq = parseInt(window.localStorage.getItem('traceSeq')) || 0;
+  window.localStorage.setItem('traceSeq', seq + 1);
+  var line = 'TRACE ' + seq + ' ' + Date.now() + ' ' + hex;
+  console.log(line);
+  var records = this.load();
+  records.push(line);
+  if (records.length > TRACE_MAX_RECORDS) {
+    records.splice(0, records.length - TRACE_MAX_RECORDS);
+  }
+  window.localStorage.setItem('trace', JSON.stringify(records));
+}
+
+/**
+ * Logs the stored trace, if tracing is on. Throws it away if not.
+ *
+ * @this {TrafficRecorder}
+ */
+TrafficRecorder.prototype.logStored = function() {
+  if (!Options.getSavedOptions().traceMode) {
+    window.localStorage.removeItem('trace');
+    this.records = null;
+    return;
+  }
+  var records = this.load();
+  console.log('Stored App Message trace (' + records.length + ' messages):');
+  records.forEach(function(line) { console.log(line); });
+}
+
+/** The recorder of all messages sent in this session. */
+var trafficRecorder = new TrafficRecorder();
+
+/**
+ * Creates an instance of TransferSender.
+ *
+ * @class Sends App Messages that are too big for the watch's inbox, split 
+ *        into numbered chunks (see transfer.h). One transfer is sent at a 
+ *        time, with up to TRANSFER_WINDOW chunks waiting for an ack instead 
+ *        of stopping to wait after each one. Chunks the watch fails to ack 
+ *        are resent after a delay. When the watch reports chunks missing 
+ *        (XFER_NACK_KEY), only those are resent.
+ * @this {TransferSender}
+ */
+function TransferSender() {
+  this.queue = [];        // transfers waiting their turn, oldest first
+  this.current = null;    // the transfer being sent
+  this.lastDone = null;   // the last finished transfer, in case of a NACK
+  // Start somewhere random, so a restarted phone app doesn't reuse the ID of
+  // a transfer the watch just finished:
+  this.nextId = Math.floor(Math.random() * 256);
+}
+
+/**
+ * Queues a message for transfer.
+ *
+ * @this {TransferSender}
+ * @param {Object} fields Message values keyed by App Message key name, as in
+ *        serializeAppMessage.
+ * @param {function()} onSuccess Called once the watch acked every chunk.
+ * @param {function()} onFailure Called if the transfer is abandoned.
+ */
+TransferSender.prototype.send = function(fields, onSuccess, onFailure) {
+  var bytes = serializeAppMessage(fields);
+  var count = Math.ceil(bytes.length / TRANSFER_CHUNK_SIZE);
+  if (count > TRANSFER_MAX_CHUNKS) {
+    throw new Error('App Message too big to transfer: ' + bytes.length);
+  }
+  var id = this.nextId;
+  this.nextId = (this.nextId + 1) % 256;
+  var chunks = [];
+  for (var seq = 0; seq < count; seq++) {
+    var data = bytes.slice(seq * TRANSFER_CHUNK_SIZE, 
+        (seq + 1) * TRANSFER_CHUNK_SIZE);
+    chunks.push({ bytes: [id, seq, count].concat(data), state: 'pending' });
+  }
+  this.queue.push({
+    id: id,
+    chunks: chunks,
+    failures: 0,
+    onSuccess: onSuccess,
+    onFailure: onFailure,
+  });
+  this.pump();
+}
+
+/**
+ * Sends as many chunks of the current transfer as the window allows, and 
+ * moves on to the next transfer once every chunk is acked.
+ *
+ * @this {TransferSender}
+ */
+TransferSender.prototype.pump = function() {
+  if (!this.current) this.current = this.queue.shift() || null;
+  var transfer = this.current;
+  if (!transfer) return;
+  var chunks = transfer.chunks;
+  var countInState = function(state) {
+    return chunks.filter(function(chunk) { return chunk.state == state; })
+        .length;
+  };
+  if (countInState('acked') == chunks.length) {
+    log.debug('Transfer ' + transfer.id + ' of ' + chunks.length + 
+        ' chunks complete.');
+    this.current = null;
+    this.lastDone = transfer;
+    if (transfer.onSuccess) transfer.onSuccess();
+    this.pump();
+    return;
+  }
+  for (var i = 0; i < chunks.length && this.current === transfer; i++) {
+    if (countInState('inFlight') >= TRANSFER_WINDOW) break;
+    if (chunks[i].state == 'pending') this.sendChunk(transfer, chunks[i]);
+  }
+}
+
+/**
+ * Sends one chunk.
+ *
+ * @this {TransferSender}
+ * @param {Object} transfer The transfer the chunk belongs to.
+ * @param {Object} chunk The chunk to send.
+ */
+TransferSender.prototype.sendChunk = function(transfer, chunk) {
+  var sender = this;
+  chunk.state = 'inFlight';
+  sendAppMessage({ 'XFER_CHUNK_KEY': chunk.bytes },
+    function(e) {
+      chunk.state = 'acked';
+      sender.pump();
+    },
+    function(e) {
+      chunk.state = 'pending';
+      if (++transfer.failures > TRANSFER_MAX_FAILURES) {
+        sender.abort(transfer);
+      } else {
+        setTimeout(function() { sender.pump(); }, TRANSFER_RETRY_MS);
+      }
+    });
+}
+
+/**
+ * Gives up on a transfer the watch keeps failing to ack.
+ *
+ * @this {TransferSender}
+ * @param {Object} transfer The transfer to abandon.
+ */
+TransferSender.prototype.abort = function(transfer) {
+  if (this.current !== transfer) return;
+  log.warning('Abandoning transfer ' + transfer.id + '!');
+  this.current = null;
+  if (transfer.onFailure) transfer.onFailure();
+  this.pump();
+}
+
+/**
+ * Resends the chunks the watch reports missing. A NACK can also arrive just
+ * after the phone saw a transfer complete; that transfer is reopened, unless
+ * something newer is already on its way.
+ *
+ * @this {TransferSender}
+ * @param {number} nack An XFER_NACK_KEY value: (transfer ID << 16) | 
+ *        bitmask of missing chunks.
+ */
+TransferSender.prototype.handleNack = function(nack) {
+  var id = (nack >> 16) & 0xFF;
+  var transfer = null;
+  if (this.current && this.current.id == id) {
+    transfer = this.current;
+  } else if (this.lastDone && this.lastDone.id == id && !this.current && 
+      !this.queue.length) {
+    transfer = this.lastDone;
+    this.lastDone = null;
+    this.current = transfer;
+  }
+  if (!transfer) {
+    log.debug('Ignoring NACK for old transfer ' + id + '.');
+    return;
+  }
+  transfer.chunks.forEach(function(chunk, seq) {
+    if ((nack & (1 << seq)) && chunk.state == 'acked') chunk.state = 'pending';
+  });
+  log.info('Watch NACKed transfer ' + id + '. Resending chunks.');
+  this.pump();
+}
+
+/** The sender of all chunked messages in this session. */
+var transferSender = new TransferSender();
+
+/**
+ * Inform the watch how often it should update New Relic data, and whether it
+ * should record the messages it receives.
  *
  * Pebble doesn't have a great way to get JS-provided config data onto the 
  * watch, so we have to remember to send it at each startup and on changes, 
  * and we have to retry until the watch acks the setting. (All config changes
- * are idempotent.)
+ * are idempotent.) In adaptive mode, this is also sent whenever the cadence 
+ * changes.
  */
 function transmitCurrentUpdateFreq() {
-  var mins = Options.getSavedOptions().updateFreq;
+  var mins = pollCadence.getFreq();
   if (!mins) return;
-  Pebble.sendAppMessage({ 
+  sendAppMessage({ 
     'UPDATE_FREQ_KEY': mins,
+    'TRACE_KEY': Options.getSavedOptions().traceMode ? 1 : 0,
   },
   function(e) { 
     /** 
      * Called when the watch acks this App Message.
      */
-    console.log('Watched acked update freq setting of ' + mins + ' mins.'); 
+    log.debug('Watched acked update freq setting of ' + mins + ' mins.'); 
   },
   function (e) {
     /** 
@@ -144,71 +1209,636 @@ function transmitCurrentUpdateFreq() {
      * changes mixing with retries since retries will fetch the latest config
      * values.
      */
-    console.log('Watch failed to acknowledge a change in update frequency! ' +
+    log.warning('Watch failed to acknowledge a change in update frequency! ' +
       'Will retry.');
     setTimeout(function() { transmitCurrentUpdateFreq(); }, 10000);
   });
-  console.log('Sent message to watch to set update frequency to ' + mins + 
+  log.info('Sent message to watch to set update frequency to ' + mins + 
       ' minutes.');
 }
 
+/**
+ * Creates an instance of FetchCoordinator.
+ *
+ * @class Runs New Relic data fetches so that no work is wasted, and answers
+ *        watch requests from a cache while revalidating it. 
+ *        - Requests that arrive while a fetch is running are merged into it,
+ *          and requests right after one finishes reuse its result.
+ *        - The last result is kept in localStorage. If it's younger than the
+ *          configured max age, the watch gets it at once (with its age) while
+ *          we fetch a fresh copy.
+ *        - Fetches are conditional (ETag/Last-Modified) when New Relic 
+ *          supports it.
+ *        - Results the watch already has aren't sent again, unless the watch
+ *          asks for them or hasn't heard from us in a while.
+ * @this {FetchCoordinator}
+ */
+function FetchCoordinator() {
+  this.inFlight = false;      // whether a fetch is running
+  this.forceSend = false;     // whether a merged request needs a resend
+  this.cache = FetchCoordinator.loadCache();  // last result, or null
+  this.lastPayloadHash = null;  // hash of the last payload the watch acked
+  this.lastSentAt = 0;        // when the watch last acked a payload (ms)
+  this.lastSeriesHash = null;   // hash of the last series the watch acked
+  this.retired = false;       // whether a newer coordinator replaced this one
+}
+
+/** Requests within this long (ms) after a fetch reuse its result. */
+FetchCoordinator.REUSE_MS = 10000;
 /** 
- * Fetches our core New Relic metrics for the app as configured in the 
- * currently saved Options, and sends the data to the watch.
+ * Unchanged data is still sent after this many poll intervals of silence, so
+ * the watch doesn't flag it as stale (it does after 3).
+ */
+FetchCoordinator.MAX_SILENT_POLLS = 2;
+/** localStorage key for the cached result. */
+FetchCoordinator.CACHE_KEY = 'metricsCache';
+
+/**
+ * Hashes a string (djb2). Only used to spot repeated payloads.
+ *
+ * @param {string} str The string to hash.
+ * @return {number} A 32-bit hash.
+ */
+FetchCoordinator.hash = function(str) {
+  var hash = 5381;
+  for (var i = 0; i < str.length; i++) {
+    hash = ((hash * 33) ^ str.charCodeAt(i)) | 0;
+  }
+  return hash;
+}
+
+/**
+ * Pulls our core metrics out of a New Relic API response.
+ *
+ * @param {Object} response A parsed /applications/<id>.json response.
+ * @return {Object} Metrics as passed to encodeMetricFields.
+ */
+FetchCoordinator.mapMetrics = function(response) {
+  var appSummary = response['application']['application_summary'] || {};
+  // The summary is missing entirely if the app is not reporting data, and
+  // apdex is null at 0rpm. encodeMetricFields zeroes any missing values.
+  return {
+    apdexScore: appSummary['apdex_score'],
+    errorRate: appSummary['error_rate'],
+    responseTime: appSummary['response_time'],
+    throughput: appSummary['throughput'],
+  };
+}
+
+/**
+ * Returns the cached result saved by saveCache, if any.
+ *
+ * @return {Object} Cache entry with attributes appIds (as in getAppIds), 
+ *         fetchedAt (ms), apps, overview (as passed to encodeOverview) and 
+ *         series (packed, or null); or null. Each app has attributes id, 
+ *         name, metrics, hosts (or null if unknown), etag and lastModified.
+ */
+FetchCoordinator.loadCache = function() {
+  try {
+    return JSON.parse(window.localStorage.getItem(FetchCoordinator.CACHE_KEY));
+  } catch (err) {
+    return null;
+  }
+}
+
+/**
+ * Stops this coordinator from using the result of a fetch still running, 
+ * because a new coordinator replaced it (e.g. for new config). The fetch is
+ * left to finish, but its result is thrown away instead of being cached, 
+ * fed to pollCadence or sent to the watch.
+ *
+ * @this {FetchCoordinator}
+ */
+FetchCoordinator.prototype.retire = function() {
+  this.retired = true;
+}
+
+/**
+ * Persists the current cached result.
+ *
+ * @this {FetchCoordinator}
+ */
+FetchCoordinator.prototype.saveCache = function() {
+  window.localStorage.setItem(FetchCoordinator.CACHE_KEY, 
+      JSON.stringify(this.cache));
+}
+
+/**
+ * @return {string} The currently configured app IDs, comma-separated, or null
+ *         if the apps aren't configured.
  */
-function fetchNewrelicData() {
+FetchCoordinator.getAppIds = function() {
   var options = Options.getSavedOptions();
-  if (!options.apiKey || !options.appId) {
-    console.log('Trying to poll New Relic API, but config data missing!');
+  if (!options.apiKey || !options.appIds.length) return null;
+  return options.appIds.join(',');
+}
+
+/**
+ * Returns the cached result if it's for the current apps and young enough to
+ * show.
+ *
+ * @this {FetchCoordinator}
+ * @param {number} maxAge Max acceptable age in ms.
+ * @return {Object} The cache entry, or null.
+ */
+FetchCoordinator.prototype.getCache = function(maxAge) {
+  var cache = this.cache;
+  if (!cache || cache.appIds != FetchCoordinator.getAppIds()) return null;
+  return (Date.now() - cache.fetchedAt < maxAge) ? cache : null;
+}
+
+/**
+ * Requests up to date New Relic data for the watch.
+ *
+ * @this {FetchCoordinator}
+ * @param {boolean} forceSend Send the result even if the watch already has it.
+ */
+FetchCoordinator.prototype.request = function(forceSend) {
+  this.forceSend = this.forceSend || !!forceSend;
+  if (this.inFlight) {
+    log.debug('Merging data request into the fetch in progress.');
     return;
   }
-  console.log('Polling New Relic API for new data.');
+  if (this.getCache(FetchCoordinator.REUSE_MS)) {
+    log.debug('Reusing data fetched moments ago.');
+    this.deliver();
+    return;
+  }
+  var maxAge = Options.getSavedOptions().cacheMaxAge * 60000;
+  if (this.getCache(maxAge)) {
+    log.debug('Sending cached data while revalidating.');
+    this.deliver();
+  }
+  this.fetch();
+}
+
+/**
+ * Runs a GET request against the New Relic API. Errors are logged here, so
+ * callers only need to handle the outcome.
+ *
+ * @param {string} url The URL to fetch.
+ * @param {string} apiKey The user's New Relic API key.
+ * @param {number} timeout Max time (in ms) to wait for the response.
+ * @param {Object} headers Extra request headers, keyed by name.
+ * @param {string} what What's being fetched, for the log.
+ * @param {function(XMLHttpRequest)} callback Called with the finished
+ *        request if New Relic answered 200 or 304, or with null if not.
+ */
+function newrelicGet(url, apiKey, timeout, headers, what, callback) {
   var req = new XMLHttpRequest();
-  req.open('GET', NEWRELIC_API_URL + '/applications/' + options.appId + '.json', 
-      true);
-  req.setRequestHeader('X-Api-Key', options.apiKey);
-  req.timeout = AJAX_TIMEOUT;
+  req.open('GET', url, true);
+  req.setRequestHeader('X-Api-Key', apiKey);
+  for (var name in headers) req.setRequestHeader(name, headers[name]);
+  req.timeout = timeout;
   req.onload = function(e) {
-    if (req.status == 200) {
-      console.log('Received successful response from New Relic API: ' + 
-          req.responseText);
-      var response = JSON.parse(req.responseText);
-      var appSummary = response['application']['application_summary'];
-      if (appSummary) {
-        var apdexScore = appSummary['apdex_score'] || 0;  // null apdex if 0rpm
-        Pebble.sendAppMessage({ 
-          'APP_NAME_KEY': response['application']['name'],
-          'APP_RESPONSE_TIME_KEY': appSummary['response_time'].toString(),
-          // ^ Pebble doesn't have floats.
-          'APP_THROUGHPUT_KEY': appSummary['throughput'],
-          'APP_ERROR_RATE_KEY': appSummary['error_rate'].toString(),
-          'APP_APDEX_SCORE_KEY': apdexScore.toFixed(2).toString(),
-        });
-      } else {
-        // The application is not reporting data.
-        Pebble.sendAppMessage({
-          'APP_NAME_KEY': response['application']['name'],
-          'APP_RESPONSE_TIME_KEY': '0',
-          'APP_THROUGHPUT_KEY': 0,
-          'APP_ERROR_RATE_KEY': '0',
-          'APP_APDEX_SCORE_KEY': '0.00',
-        });
-      }
-      console.log('Sent new New Relic data to watch.');
-    } else { 
-      console.log('Error fetching New Relic data! Response code ' + 
-          req.status + ', body: ' + req.responseText); 
+    if (req.status == 200 || req.status == 304) {
+      callback(req);
+    } else {
+      log.error('Error fetching ' + what + '! Response code ' + req.status +
+          ', body: ' + req.responseText);
+      callback(null);
     }
   }
-  req.onerror = function(e) { 
-    console.log('Network error while fetching New Relic data!'); 
+  req.onerror = function(e) {
+    log.warning('Network error while fetching ' + what + '!');
+    callback(null);
   }
-  req.ontimeout = function(e) { 
-    console.log('Timeout fetching New Relic data!'); 
+  req.ontimeout = function(e) {
+    log.warning('Timeout fetching ' + what + '!');
+    callback(null);
   }
   req.send(null);
 }
 
+/**
+ * Runs asynchronous jobs, at most FETCH_CONCURRENCY at a time, and waits for
+ * all of them, or until FETCH_DEADLINE. A failed job doesn't hold up or 
+ * cancel the others.
+ *
+ * @param {Array} jobs Functions that each take a callback and call it once,
+ *        with their result, or with null if they failed.
+ * @param {function(Array)} onDone Called once with the results, in job 
+ *        order. Jobs that didn't finish by the deadline get null.
+ */
+function runParallel(jobs, onDone) {
+  var results = jobs.map(function() { return null; });
+  var next = 0;
+  var pending = jobs.length;
+  var done = false;
+  var finish = function() {
+    if (done) return;
+    done = true;
+    clearTimeout(deadline);
+    onDone(results);
+  };
+  var startNext = function() {
+    var index = next++;
+    var called = false;
+    jobs[index](function(result) {
+      if (called || done) return;
+      called = true;
+      results[index] = result;
+      if (next < jobs.length) startNext();
+      if (--pending == 0) finish();
+    });
+  };
+  var deadline = setTimeout(function() {
+    log.warning('New Relic fetch took too long! Giving up on ' + pending + 
+        ' requests.');
+    finish();
+  }, FETCH_DEADLINE);
+  var workers = Math.min(FETCH_CONCURRENCY, jobs.length);
+  for (var i = 0; i < workers; i++) startNext();
+  if (!jobs.length) finish();
+}
+
+/**
+ * Fetches the core metrics of a single app.
+ *
+ * @param {string} apiKey The user's New Relic API key.
+ * @param {string} appId The app to fetch.
+ * @param {Object} cached The app's entry from the previous fetch, for
+ *        conditional requests; or null.
+ * @param {function(Object)} callback Called with the app's new cache entry
+ *        (as in loadCache), or with null if the fetch failed.
+ */
+FetchCoordinator.fetchApp = function(apiKey, appId, cached, callback) {
+  var url = NEWRELIC_API_URL + '/applications/' + appId + '.json';
+  var headers = {};
+  if (cached && cached.etag) headers['If-None-Match'] = cached.etag;
+  if (cached && cached.lastModified) {
+    headers['If-Modified-Since'] = cached.lastModified;
+  }
+  newrelicGet(url, apiKey, FETCH_TIMEOUTS.app, headers, 'app ' + appId,
+      function(req) {
+        if (!req) {
+          callback(null);
+        } else if (req.status == 304 && cached) {
+          log.debug('New Relic data for app ' + appId + ' not modified.');
+          callback(cached);
+        } else {
+          log.debug(function() {
+            return 'Received successful response for app ' + appId + ': ' +
+                req.responseText;
+          });
+          var app;
+          try {
+            var response = JSON.parse(req.responseText);
+            var links = response['application']['links'] || {};
+            app = {
+              id: appId,
+              name: response['application']['name'],
+              metrics: FetchCoordinator.mapMetrics(response),
+              hosts: links['application_hosts'] ?
+                  links['application_hosts'].length : null,
+              etag: req.getResponseHeader('ETag'),
+              lastModified: req.getResponseHeader('Last-Modified'),
+            };
+          } catch (err) {
+            // E.g. a captive portal's login page instead of our JSON:
+            log.error('Unexpected response for app ' + appId + ': ' +
+                err.message);
+            app = null;
+          }
+          callback(app);
+        }
+      });
+}
+
+/**
+ * Counts the account's open alert violations. Only the first page of them is
+ * fetched; if there are more, that's all we say.
+ *
+ * @param {string} apiKey The user's New Relic API key.
+ * @param {function(Object)} callback Called with an object with attributes
+ *        count and more (whether there's another page), or with null if the
+ *        fetch failed.
+ */
+FetchCoordinator.fetchViolations = function(apiKey, callback) {
+  var url = NEWRELIC_API_URL + '/alerts_violations.json?only_open=true';
+  newrelicGet(url, apiKey, FETCH_TIMEOUTS.violations, {},
+      'alert violations', function(req) {
+        if (!req) {
+          callback(null);
+          return;
+        }
+        var violations;
+        try {
+          violations = {
+            count: JSON.parse(req.responseText)['violations'].length,
+            more: /rel="next"/.test(req.getResponseHeader('Link') || ''),
+          };
+        } catch (err) {
+          log.error('Unexpected alert violations response: ' + err.message);
+          violations = null;
+        }
+        callback(violations);
+      });
+}
+
+/**
+ * Finds the account's slowest key transaction.
+ *
+ * @param {string} apiKey The user's New Relic API key.
+ * @param {function(Object)} callback Called with an object whose attribute
+ *        slowest is the key transaction with the highest response time (with
+ *        attributes name and responseTime in ms), or null if none is
+ *        reporting; or with null if the fetch failed.
+ */
+FetchCoordinator.fetchKeyTransactions = function(apiKey, callback) {
+  var url = NEWRELIC_API_URL + '/key_transactions.json';
+  newrelicGet(url, apiKey, FETCH_TIMEOUTS.keyTransactions, {},
+      'key transactions', function(req) {
+        if (!req) {
+          callback(null);
+          return;
+        }
+        var slowest = null;
+        try {
+          JSON.parse(req.responseText)['key_transactions'].forEach(
+              function(transaction) {
+                // The summary is missing if the transaction isn't reporting:
+                var summary = transaction['application_summary'];
+                if (!summary || typeof summary['response_time'] != 'number') {
+                  return;
+                }
+                if (!slowest || 
+                    summary['response_time'] > slowest.responseTime) {
+                  slowest = {
+                    name: transaction['name'],
+                    responseTime: summary['response_time'],
+                  };
+                }
+              });
+        } catch (err) {
+          log.error('Unexpected key transactions response: ' + err.message);
+          callback(null);
+          return;
+        }
+        callback({ slowest: slowest });
+      });
+}
+
+/**
+ * Fetches a time series of one metric of the primary app from New Relic's
+ * metric data API, as configured in the given Options. The series is
+ * downsampled to the watch's screen width, so the payload stays small
+ * however long the time window.
+ *
+ * @param {Options} options The currently saved Options, with series mode on.
+ * @param {function(Array)} callback Called with the packed series (as
+ *        produced by encodeSeries), or with null if the fetch failed.
+ */
+FetchCoordinator.fetchSeries = function(options, callback) {
+  var metric = SERIES_METRICS[options.seriesMetric];
+  var to = new Date();
+  var from = new Date(to.getTime() - options.seriesWindow * 60000);
+  var url = NEWRELIC_API_URL + '/applications/' + options.appIds[0] +
+      '/metrics/data.json?names[]=' + encodeURIComponent(metric.name) +
+      '&values[]=' + encodeURIComponent(metric.value) +
+      '&from=' + encodeURIComponent(from.toISOString()) +
+      '&to=' + encodeURIComponent(to.toISOString());
+  newrelicGet(url, options.apiKey, FETCH_TIMEOUTS.series, {},
+      'New Relic time series', function(req) {
+        if (!req) {
+          callback(null);
+          return;
+        }
+        var points;
+        try {
+          var timeslices = JSON.parse(req.responseText)['metric_data']
+              ['metrics'][0]['timeslices'];
+          points = timeslices.map(function(timeslice) {
+            return {
+              x: Date.parse(timeslice['from']),
+              y: (timeslice['values'][metric.value] || 0) * metric.scale,
+            };
+          });
+        } catch (err) {
+          log.error('Unexpected New Relic time series response: ' +
+              err.message);
+          callback(null);
+          return;
+        }
+        var sampled = downsampleLttb(points, SERIES_MAX_POINTS);
+        log.debug('Downsampled time series from ' + points.length + ' to ' +
+            sampled.length + ' points.');
+        callback(encodeSeries(metric.id, options.seriesWindow,
+            sampled.map(function(point) { return point.y; })));
+      });
+}
+
+/**
+ * Fetches everything the watch shows for the currently saved Options: the
+ * core metrics of every configured app, the account overview (open alert
+ * violations and the slowest key transaction) and, in series mode, the
+ * primary app's time series. All requests run in parallel (see runParallel),
+ * each with its own timeout. Once all of them are in, what they returned is
+ * cached and passed to deliver as one update. Parts whose fetch failed keep
+ * their previous result, if we have one; only a fetch where every app failed
+ * counts as a failure.
+ *
+ * @this {FetchCoordinator}
+ */
+FetchCoordinator.prototype.fetch = function() {
+  var appIdsKey = FetchCoordinator.getAppIds();
+  if (!appIdsKey) {
+    log.warning('Trying to poll New Relic API, but config data missing!');
+    return;
+  }
+  var options = Options.getSavedOptions();
+  var appIds = options.appIds;
+  var previous = {};  // entries from the last fetch, by app ID
+  if (this.cache && this.cache.apps) {
+    this.cache.apps.forEach(function(app) { previous[app.id] = app; });
+  }
+  // The rest of the last result only still applies if the config didn't
+  // change since:
+  var prior = (this.cache && this.cache.appIds == appIdsKey) ? this.cache : {};
+  var priorOverview = prior.overview || {
+    violations: null, moreViolations: false, keyTransaction: null,
+  };
+  log.info('Polling New Relic API for ' + appIds.length + ' apps.');
+
+  var jobs = appIds.map(function(appId) {
+    return function(callback) {
+      FetchCoordinator.fetchApp(options.apiKey, appId, previous[appId] || null,
+          callback);
+    };
+  });
+  jobs.push(function(callback) {
+    FetchCoordinator.fetchViolations(options.apiKey, callback);
+  });
+  jobs.push(function(callback) {
+    FetchCoordinator.fetchKeyTransactions(options.apiKey, callback);
+  });
+  jobs.push(function(callback) {
+    if (options.seriesMode) {
+      FetchCoordinator.fetchSeries(options, callback);
+    } else {
+      // An empty series clears the watch's chart:
+      callback(encodeSeries(0, 0, []));
+    }
+  });
+
+  var coordinator = this;
+  this.inFlight = true;
+  runParallel(jobs, function(results) {
+    coordinator.inFlight = false;
+    if (coordinator.retired) {
+      log.debug('Discarding a fetch made with the previous config.');
+      return;
+    }
+    var apps = [];
+    var fetchedAny = false;
+    for (var i = 0; i < appIds.length; i++) {
+      fetchedAny = fetchedAny || !!results[i];
+      var app = results[i] || previous[appIds[i]];
+      if (app) apps.push(app);
+    }
+    if (!fetchedAny) {
+      pollCadence.onFailure();
+      return;
+    }
+    var violations = results[appIds.length];
+    var keyTransactions = results[appIds.length + 1];
+    coordinator.cache = {
+      appIds: appIdsKey,
+      fetchedAt: Date.now(),
+      apps: apps,
+      overview: {
+        violations: violations ? violations.count : priorOverview.violations,
+        moreViolations: violations ? violations.more :
+            priorOverview.moreViolations,
+        keyTransaction: keyTransactions ? keyTransactions.slowest :
+            priorOverview.keyTransaction,
+      },
+      series: results[appIds.length + 2] || prior.series || null,
+    };
+    coordinator.saveCache();
+    pollCadence.onSuccess(apps.map(function(app) { return app.metrics; }));
+    coordinator.deliver();
+  });
+}
+
+/**
+ * Sends the cached result to the watch in a single transfer: the app table,
+ * the overview and, if the watch doesn't have it yet, the series. A series
+ * too big to share the transfer with a full app table gets one of its own.
+ * Nothing is sent if the watch already has it all. Results older than a poll
+ * interval are marked stale on the watch, so an otherwise identical fresh
+ * result still gets sent to clear that.
+ *
+ * @this {FetchCoordinator}
+ */
+FetchCoordinator.prototype.deliver = function() {
+  var cache = this.cache;
+  var ageSecs = Math.floor((Date.now() - cache.fetchedAt) / 1000);
+  var isStale = ageSecs >= pollCadence.getFreq() * 60;
+  var fields = {
+    'APP_TABLE_KEY': encodeAppTable(cache.apps),
+    // Caches saved before the overview existed don't have one:
+    'OVERVIEW_KEY': encodeOverview(cache.overview || { violations: null },
+        cache.apps),
+  };
+  var hash = FetchCoordinator.hash(JSON.stringify(fields) + isStale);
+  var maxSilence = FetchCoordinator.MAX_SILENT_POLLS * pollCadence.getFreq() *
+      60000;
+  var sendData = this.forceSend || hash != this.lastPayloadHash ||
+      Date.now() - this.lastSentAt >= maxSilence;
+  var series = cache.series || null;
+  var seriesHash = series ? FetchCoordinator.hash(JSON.stringify(series)) :
+      null;
+  var sendSeries = !!series &&
+      (this.forceSend || seriesHash != this.lastSeriesHash);
+  if (!sendData && !sendSeries) {
+    log.debug('New Relic data unchanged. Not sending it to the watch.');
+    return;
+  }
+  this.forceSend = false;
+  if (ageSecs > 0) fields['DATA_AGE_KEY'] = ageSecs;
+
+  var coordinator = this;
+  var send = function(fields, dataHash, seriesHash) {
+    transferSender.send(fields, function() {
+      if (dataHash !== null) {
+        coordinator.lastPayloadHash = dataHash;
+        coordinator.lastSentAt = Date.now();
+      }
+      if (seriesHash !== null) coordinator.lastSeriesHash = seriesHash;
+    }, function() {
+      log.warning('Watch failed to acknowledge New Relic data!');
+      if (dataHash !== null) coordinator.lastPayloadHash = null;
+    });
+  };
+  if (!sendData) {
+    send({ 'SERIES_KEY': series }, null, seriesHash);
+  } else if (!sendSeries) {
+    send(fields, hash, null);
+  } else {
+    fields['SERIES_KEY'] = series;
+    if (serializeAppMessage(fields).length <=
+        TRANSFER_CHUNK_SIZE * TRANSFER_MAX_CHUNKS) {
+      send(fields, hash, seriesHash);
+    } else {
+      delete fields['SERIES_KEY'];
+      send(fields, hash, null);
+      send({ 'SERIES_KEY': series }, null, seriesHash);
+    }
+  }
+  if (sendData) {
+    log.info(function() {
+      return 'Sent New Relic data (' + ageSecs + 's old) to watch: ' +
+          JSON.stringify(decodeAppTable(fields['APP_TABLE_KEY'])) +
+          ', overview: ' + JSON.stringify(cache.overview);
+    });
+  }
+  if (sendSeries) {
+    log.info('Sent ' + series[12] + ' point time series to watch.');
+  }
+}
+
+/** The coordinator for all fetches in this session. */
+var fetchCoordinator = new FetchCoordinator();
+
+/** 
+ * Fetches our core New Relic metrics for the apps as configured in the 
+ * currently saved Options, and sends the data to the watch if it changed.
+ *
+ * @param {boolean} forceSend Send the data even if the watch already has it.
+ */
+function fetchNewrelicData(forceSend) {
+  fetchCoordinator.request(forceSend);
+}
+
+/**
+ * Asks the watch for a snapshot of its hot-path timings and message counters.
+ * The answer arrives as a PERF_STATS_KEY App Message.
+ */
+function requestPerfStats() {
+  sendAppMessage({ 'PERF_REQ_KEY': 1 },
+    function(e) {},
+    function(e) { log.warning('Watch failed to ack stats request.'); }
+  );
+}
+
+/**
+ * Logs a stats snapshot from the watch and keeps it for the config page.
+ *
+ * @param {Array} bytes The packed snapshot (PERF_STATS_KEY).
+ */
+function handlePerfStats(bytes) {
+  var stats = decodePerfStats(bytes);
+  if (!stats) {
+    log.warning('Ignoring malformed watch stats.');
+    return;
+  }
+  var text = formatPerfStats(stats).join('\n');
+  log.info(text);
+  window.localStorage.setItem('perfStats', 
+      new Date().toLocaleString() + '\n' + text);
+}
+
 
 /************************ 
  * Pebble event handlers:
@@ -220,13 +1850,14 @@ function fetchNewrelicData() {
  */
 Pebble.addEventListener('ready',
   function(e) {
-    console.log('PebbleKit JS initialized.');
+    log.info('PebbleKit JS initialized.');
+    trafficRecorder.logStored();
     transmitCurrentUpdateFreq();
-    fetchNewrelicData();
+    fetchNewrelicData(true);
     // PEBBLE BUG?: When an inbound app message triggers the initialization of
     // the JS app on the phone, that message's "appmessage" event often fails
-    // to fire. We eagerly send New Relic data here to counter that, but it 
-    // sometimes results in doing duplicate data fetches at startup.
+    // to fire. We eagerly send New Relic data here to counter that. When the
+    // event does fire, the FetchCoordinator merges it into this fetch.
   }
 );
 
@@ -235,23 +1866,29 @@ Pebble.addEventListener('ready',
  * Options object.
  */
 Pebble.addEventListener('webviewclosed', function(e) {
-  console.log('Configuration window closed: ' + JSON.stringify(e));
+  log.debug(function() {
+    return 'Configuration window closed: ' + JSON.stringify(e);
+  });
   if (!e.response || e.response == '{}') {
-    console.log('No options returned from configuration.');
+    log.info('No options returned from configuration.');
     return;
   }
   try { 
     // Cancelling config with the Android back button returns 'CANCELLED' as 
     // the response, which wasn't in the Pebble docs... Let's be safe.
-    console.log('User submitted (possibly new) configuration.');
+    log.info('User submitted (possibly new) configuration.');
     var serializedOptions = JSON.parse(decodeURIComponent(e.response));
     Options.fromObject(serializedOptions).save();
+    pollCadence = new PollCadence();
+    fetchCoordinator.retire();
+    fetchCoordinator = new FetchCoordinator();
+    log.reload();
   } catch (err) {
-    console.log('Error updating config. ' + err.message);
+    log.error('Error updating config. ' + err.message);
     return;
   }
   transmitCurrentUpdateFreq();
-  fetchNewrelicData();
+  fetchNewrelicData(true);
 });
 
 /** 
@@ -260,10 +1897,16 @@ Pebble.addEventListener('webviewclosed', function(e) {
  */
 Pebble.addEventListener('showConfiguration', function() {
   var options = Options.getSavedOptions();
-  console.log('Prepping config page. Previously saved options: ' + 
-    JSON.stringify(options));
+  log.debug(function() {
+    return 'Prepping config page. Previously saved options: ' + 
+        JSON.stringify(options);
+  });
+  // The page shows the last stats the watch sent, and we ask for fresh ones
+  // for next time:
+  options.watchStats = window.localStorage.getItem('perfStats') || '';
+  requestPerfStats();
   var url = CONFIG_PAGE_URL + '#' + encodeURIComponent(JSON.stringify(options));
-  console.log('Loading configuration page: ' + url);
+  log.debug('Loading configuration page: ' + url);
   Pebble.openURL(url);
 });
 
@@ -272,8 +1915,19 @@ Pebble.addEventListener('showConfiguration', function() {
  * watch.
  */
 Pebble.addEventListener('appmessage', function(e) {
-  console.log('Phone received message from watch: ' + JSON.stringify(e));
-  if (e['payload']['UPDATE_REQ_KEY']) {
-    fetchNewrelicData();
+  log.debug(function() {
+    return 'Phone received message from watch: ' + JSON.stringify(e);
+  });
+  var updateReq = getAppMessageValue(e['payload'], 'UPDATE_REQ_KEY');
+  if (updateReq) {
+    fetchNewrelicData(updateReq == UPDATE_REQ_FULL);
+  }
+  var nack = getAppMessageValue(e['payload'], 'XFER_NACK_KEY');
+  if (nack !== undefined) {
+    transferSender.handleNack(nack);
+  }
+  var perfStats = getAppMessageValue(e['payload'], 'PERF_STATS_KEY');
+  if (perfStats !== undefined) {
+    handlePerfStats(perfStats);
   }
 });
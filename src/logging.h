@@ -0,0 +1,50 @@
+/**
+ * @section DESCRIPTION
+ *
+ * Level-gated wrappers around APP_LOG. The level is fixed at compile time
+ * (LOG_LEVEL, set by `waf configure --log-level`), and calls below it are
+ * compiled out along with their arguments: a disabled LOG_DEBUG costs no
+ * code, no format string in the binary and no argument evaluation, yet its
+ * format string is still checked against its arguments. Use these rather than
+ * APP_LOG directly, except for output the user explicitly asked for.
+ */
+
+#ifndef __LOGGING_H__
+#define __LOGGING_H__
+
+#include <pebble.h>
+
+
+/** Log levels, most severe first. */
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+/** The least severe level that's logged. Release builds stop at warnings. */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_WARNING
+#endif
+
+/**
+ * Logs at the given APP_LOG level if enabled is true. With a constant false,
+ * the compiler drops the whole call.
+ */
+#define LOG_IF(enabled, app_log_level, ...) \
+  do { \
+    if (enabled) APP_LOG(app_log_level, __VA_ARGS__); \
+  } while (0)
+
+/** Logs a printf-style message at each level. */
+#define LOG_ERROR(...) \
+  LOG_IF(LOG_LEVEL >= LOG_LEVEL_ERROR, APP_LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARNING(...) \
+  LOG_IF(LOG_LEVEL >= LOG_LEVEL_WARNING, APP_LOG_LEVEL_WARNING, __VA_ARGS__)
+#define LOG_INFO(...) \
+  LOG_IF(LOG_LEVEL >= LOG_LEVEL_INFO, APP_LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...) \
+  LOG_IF(LOG_LEVEL >= LOG_LEVEL_DEBUG, APP_LOG_LEVEL_DEBUG, __VA_ARGS__)
+
+
+#endif  // __LOGGING_H__
@@ -1,6 +1,14 @@
 #include <pebble.h>
 #include "newrelic_layer.h"
 #include "clock_layer.h"
+#include "resource_cache.h"
+#include "outbox_queue.h"
+#include "scheduler.h"
+#include "transfer.h"
+#include "inbox_trace.h"
+#include "perf_stats.h"
+#include "heap_stats.h"
+#include "logging.h"
 
 
 /** Our primary UI window. */
@@ -19,9 +27,17 @@ static Layer *clock_layer;
  * @param context Application data as specified when registering the callback.
  *        Unused.
  */
-static void app_msg_in_received_handler(DictionaryIterator *iter, void *context) {
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "Received App Message from phone.");
-  newrelic_app_msg_in_received_handler(iter, context);
+static void app_msg_in_received_handler(DictionaryIterator *iter, 
+    void *context) {
+  LOG_DEBUG("Received App Message from phone.");
+  perf_count(PERF_COUNTER_RECEIVED);
+  inbox_trace_record_received(iter);
+  // Messages that came in chunks are only dispatched once complete:
+  DictionaryIterator *message = transfer_receive(iter);
+  if (message) {
+    newrelic_app_msg_in_received_handler(message, context);
+    heap_stats_checkpoint(HEAP_CHECKPOINT_FIRST_MESSAGE);
+  }
 }
 
 /**
@@ -32,7 +48,21 @@ static void app_msg_in_received_handler(DictionaryIterator *iter, void *context)
  *        Unused.
  */
 static void app_msg_in_dropped_handler(AppMessageResult reason, void *context) {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "App Message dropped! Reason: %d", reason);
+  LOG_ERROR("App Message dropped! Reason: %d", reason);
+  perf_count(PERF_COUNTER_DROPPED);
+  inbox_trace_record_dropped(reason);
+  transfer_handle_dropped(reason, context);
+}
+
+/**
+ * A Pebble AppMessageOutboxSent (App Message delivered) handler.
+ *
+ * @param sent The message that was sent.
+ * @param context Application data as specified when registering the callback.
+ *        Unused.
+ */
+static void app_msg_out_sent_handler(DictionaryIterator *sent, void *context) {
+  outbox_queue_handle_sent(sent, context);
 }
 
 /**
@@ -45,7 +75,7 @@ static void app_msg_in_dropped_handler(AppMessageResult reason, void *context) {
  */
 static void app_msg_out_failed_handler(DictionaryIterator *failed, 
     AppMessageResult reason, void *context) {
-  APP_LOG(APP_LOG_LEVEL_ERROR, "App Message failed to send! Reason: %d", reason);
+  outbox_queue_handle_failed(failed, reason, context);
 }
 
 /**
@@ -55,22 +85,11 @@ static void app_message_init(void) {
   // Register message handlers:
   app_message_register_inbox_received(app_msg_in_received_handler);
   app_message_register_inbox_dropped(app_msg_in_dropped_handler);
+  app_message_register_outbox_sent(app_msg_out_sent_handler);
   app_message_register_outbox_failed(app_msg_out_failed_handler);
 
   // Init buffers:
-  app_message_open(NEWRELIC_DISPLAY_FIELD_SIZE, NEWRELIC_DISPLAY_FIELD_SIZE);
-}
-
-/**
- * A Pebble BluetoothConnectionHandler (BT connection state change callback).
- * Triggers refreshes when the watch reconnects to the phone.
- *
- * @param connected True on BT connection, false on disconnection.
- */
-static void handle_bluetooth_connection_change(bool connected) {
-  // Our data is likely stale after a BT disconnection, and this should not be
-  // a common event.
-  if (connected) request_newrelic_update();
+  app_message_open(NEWRELIC_INBOX_SIZE, NEWRELIC_OUTBOX_SIZE);
 }
 
 /**
@@ -82,6 +101,7 @@ static void handle_bluetooth_connection_change(bool connected) {
  */
 static void handle_minute_tick(struct tm *tick_time, TimeUnits units_changed) {
   clock_layer_handle_minute_tick(tick_time, units_changed);
+  scheduler_handle_minute_tick(tick_time);
 }
 
 /**
@@ -110,6 +130,10 @@ static void window_load(Window *window) {
       });
   layer_add_child(window_layer, newrelic_layer);
   newrelic_layer_init(newrelic_layer);
+
+  LOG_DEBUG("Shared fonts use %d heap bytes.", 
+      (int) resource_cache_heap_bytes());
+  heap_stats_checkpoint(HEAP_CHECKPOINT_WINDOW_LOAD);
 }
 
 /**
@@ -131,8 +155,12 @@ static void window_unload(Window *window) {
  * to Pebble Event Services. The companion destructor is deinit.
  */
 static void init(void) {
+  srand(time(NULL));  // for outbox retry jitter
+  perf_stats_init();
   window = window_create();
+  inbox_trace_init();
   app_message_init();
+  heap_stats_checkpoint(HEAP_CHECKPOINT_INIT);
   window_set_window_handlers(window, (WindowHandlers) {
       .load = window_load,
       .unload = window_unload,
@@ -141,13 +169,17 @@ static void init(void) {
   const bool animated = true;
   window_set_background_color(window, GColorBlack);
   window_stack_push(window, animated);
-  bluetooth_connection_service_subscribe(handle_bluetooth_connection_change);
+  bluetooth_connection_service_subscribe(newrelic_layer_handle_connection);
+  app_focus_service_subscribe(newrelic_layer_handle_focus);
+  accel_tap_service_subscribe(newrelic_layer_handle_tap);
 }
 
 /**
  * The main app deinitializer. Destroys resources created by init.
  */
 static void deinit(void) {
+  heap_stats_checkpoint(HEAP_CHECKPOINT_EXIT);
+  outbox_queue_deinit();
   window_destroy(window);
 }
 
@@ -158,7 +190,7 @@ static void deinit(void) {
  */
 int main(void) {
   init();
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "Done initializing, pushed window: %p", window);
+  LOG_DEBUG("Done initializing, pushed window: %p", window);
   app_event_loop();
   deinit();
 }
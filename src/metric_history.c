@@ -0,0 +1,279 @@
+#include <pebble.h>
+#include "metric_history.h"
+#include "persist_keys.h"
+#include "logging.h"
+
+
+/** Version of the persisted layout. Bump on incompatible changes. */
+#define HISTORY_VERSION 1
+
+/** Number of samples per persisted page. */
+#define HISTORY_PAGE_SAMPLES 30
+
+/** Number of persisted pages. */
+#define HISTORY_PAGE_COUNT (HISTORY_CAPACITY / HISTORY_PAGE_SAMPLES)
+
+/** Largest delta magnitude that fits in a slot. */
+#define MAX_DELTA 127
+
+/** Per-metric ring state. */
+typedef struct {
+  uint32_t anchor;  // value of the oldest sample
+  uint32_t latest;  // reconstructed value of the newest sample
+  uint8_t shift;    // deltas are in units of (1 << shift)
+} RingState;
+
+/** Everything but the deltas. Persisted as a whole under its own key. */
+typedef struct {
+  uint8_t version;
+  uint8_t head;             // slot of the oldest sample
+  uint8_t count;            // number of samples held
+  uint32_t last_time;       // time of the newest sample
+  RingState rings[HISTORY_METRIC_COUNT];
+} HistoryHeader;
+
+static HistoryHeader header;
+
+/** 
+ * deltas[slot][metric] is the change from the previous sample, in quanta. 
+ * The oldest sample's slot is unused. Laid out slot-major so each persisted 
+ * page is one contiguous run of slots.
+ */
+static int8_t deltas[HISTORY_CAPACITY][HISTORY_METRIC_COUNT];
+
+/** Bitmask of pages changed since the last flush. */
+static uint8_t dirty_pages;
+
+/** Samples pushed since the last flush. */
+static uint16_t unflushed_samples;
+
+_Static_assert(HISTORY_CAPACITY % HISTORY_PAGE_SAMPLES == 0, 
+    "History must split into whole pages");
+_Static_assert(sizeof(deltas) / HISTORY_PAGE_COUNT <= PERSIST_DATA_MAX_LENGTH,
+    "History pages must fit in one persist key");
+
+/**
+ * Maps a sample index (0 = oldest) to its ring slot.
+ */
+static uint8_t slot_of(uint16_t index) {
+  return (header.head + index) % HISTORY_CAPACITY;
+}
+
+/**
+ * Scales a delta back up to a value difference. Relies on unsigned wraparound,
+ * so negative deltas work too.
+ */
+static uint32_t expand_delta(int8_t delta, uint8_t shift) {
+  return (uint32_t) (int32_t) delta << shift;
+}
+
+/**
+ * Rounds a value difference to the nearest whole number of quanta.
+ */
+static int32_t quantize(int64_t diff, uint8_t shift) {
+  int64_t half = (1LL << shift) >> 1;
+  if (diff >= 0) return (int32_t) ((diff + half) >> shift);
+  return -(int32_t) ((-diff + half) >> shift);
+}
+
+/**
+ * Re-encodes one metric's deltas with a quantum twice as large, so bigger 
+ * changes fit in a byte. Done in place, feeding rounding error forward.
+ *
+ * @param metric The metric to re-encode.
+ */
+static void coarsen(HistoryMetric metric) {
+  RingState *ring = &header.rings[metric];
+  uint8_t new_shift = ring->shift + 1;
+  uint32_t old_value = ring->anchor;
+  uint32_t new_value = ring->anchor;
+  for (uint16_t i = 1; i < header.count; i++) {
+    int8_t *delta = &deltas[slot_of(i)][metric];
+    old_value += expand_delta(*delta, ring->shift);
+    int32_t q = quantize((int64_t) old_value - new_value, new_shift);
+    if (q > MAX_DELTA) q = MAX_DELTA;
+    if (q < -MAX_DELTA) q = -MAX_DELTA;
+    *delta = q;
+    new_value += expand_delta(*delta, new_shift);
+  }
+  ring->latest = new_value;
+  ring->shift = new_shift;
+  dirty_pages = (1 << HISTORY_PAGE_COUNT) - 1;
+}
+
+/**
+ * Halves one metric's quantum if every stored delta still fits afterwards.
+ * This is exact (each delta just doubles), and lets resolution recover once a
+ * spike that forced coarsen has aged out of the ring.
+ *
+ * @param metric The metric to re-encode.
+ */
+static void refine(HistoryMetric metric) {
+  RingState *ring = &header.rings[metric];
+  if (ring->shift == 0) return;
+  for (uint16_t i = 1; i < header.count; i++) {
+    int8_t delta = deltas[slot_of(i)][metric];
+    if (delta > MAX_DELTA / 2 || delta < -MAX_DELTA / 2) return;
+  }
+  for (uint16_t i = 1; i < header.count; i++) {
+    deltas[slot_of(i)][metric] *= 2;
+  }
+  ring->shift--;
+  dirty_pages = (1 << HISTORY_PAGE_COUNT) - 1;
+}
+
+/**
+ * Appends one value to a metric's ring. The slot must already be reserved.
+ *
+ * @param metric The metric to append to.
+ * @param slot The slot for the new sample.
+ * @param value The new value.
+ */
+static void append_value(HistoryMetric metric, uint8_t slot, uint32_t value) {
+  RingState *ring = &header.rings[metric];
+  int32_t q = quantize((int64_t) value - ring->latest, ring->shift);
+  while (q > MAX_DELTA || q < -MAX_DELTA) {
+    coarsen(metric);
+    q = quantize((int64_t) value - ring->latest, ring->shift);
+  }
+  deltas[slot][metric] = q;
+  ring->latest += expand_delta(q, ring->shift);
+}
+
+/**
+ * Drops the oldest sample, folding the next delta into the anchors.
+ */
+static void evict_oldest(void) {
+  uint8_t next_slot = slot_of(1);
+  for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+    RingState *ring = &header.rings[m];
+    ring->anchor += expand_delta(deltas[next_slot][m], ring->shift);
+  }
+  header.head = next_slot;
+  header.count--;
+  for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+    refine(m);
+  }
+}
+
+/**
+ * Appends one sample to a non-empty history, evicting the oldest one if the
+ * history is full.
+ *
+ * @param values The sample's value of each metric.
+ */
+static void append_sample(const uint32_t values[HISTORY_METRIC_COUNT]) {
+  if (header.count == HISTORY_CAPACITY) evict_oldest();
+  uint8_t slot = slot_of(header.count);
+  for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+    append_value(m, slot, values[m]);
+  }
+  header.count++;
+  dirty_pages |= 1 << (slot / HISTORY_PAGE_SAMPLES);
+}
+
+// Docs are in the header file.
+uint16_t metric_history_push(const NewrelicMetrics *metrics, time_t time) {
+  if (header.count > 0 && time / 60 <= (time_t) header.last_time / 60) {
+    return 0;
+  }
+  const uint32_t values[HISTORY_METRIC_COUNT] = {
+    [HISTORY_APDEX] = metrics->apdex_x100,
+    [HISTORY_ERROR_RATE] = metrics->error_rate_x100,
+    [HISTORY_RESPONSE_TIME] = metrics->response_time_us,
+    [HISTORY_THROUGHPUT] = metrics->throughput,
+  };
+  uint16_t added = 1;
+
+  if (header.count == 0) {
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+      header.rings[m] = (RingState) { .anchor = values[m], 
+          .latest = values[m] };
+    }
+    header.head = 0;
+    header.count = 1;
+  } else {
+    // Hold the last values through the minutes nothing arrived for (the 
+    // phone skips unchanged data), so every sample stays a minute apart:
+    time_t gap = time / 60 - (time_t) header.last_time / 60;
+    added = gap < HISTORY_CAPACITY ? gap : HISTORY_CAPACITY;
+    for (uint16_t i = 1; i < added; i++) {
+      uint32_t held[HISTORY_METRIC_COUNT];
+      for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        held[m] = header.rings[m].latest;
+      }
+      append_sample(held);
+    }
+    append_sample(values);
+  }
+  header.last_time = (uint32_t) time;
+  unflushed_samples += added;
+  return added;
+}
+
+// Docs are in the header file.
+uint16_t metric_history_count(void) {
+  return header.count;
+}
+
+// Docs are in the header file.
+uint32_t metric_history_latest(HistoryMetric metric) {
+  return header.rings[metric].latest;
+}
+
+// Docs are in the header file.
+void metric_history_for_each(HistoryMetric metric, uint16_t start, 
+    HistorySampleCallback callback, void *context) {
+  const RingState *ring = &header.rings[metric];
+  uint32_t value = ring->anchor;
+  for (uint16_t i = 0; i < header.count; i++) {
+    if (i > 0) value += expand_delta(deltas[slot_of(i)][metric], ring->shift);
+    if (i >= start) callback(i, value, context);
+  }
+}
+
+// Docs are in the header file.
+void metric_history_flush(void) {
+  if (unflushed_samples == 0 && dirty_pages == 0) return;
+  for (int page = 0; page < HISTORY_PAGE_COUNT; page++) {
+    if (!(dirty_pages & (1 << page))) continue;
+    persist_write_data(HISTORY_PAGE_PERSIST_KEY_BASE + page, 
+        deltas[page * HISTORY_PAGE_SAMPLES], 
+        sizeof(deltas) / HISTORY_PAGE_COUNT);
+  }
+  int result = persist_write_data(HISTORY_HEADER_PERSIST_KEY, &header, 
+      sizeof(header));
+  if (result < 0) {
+    LOG_ERROR("Failed to save history! Error: %d", result);
+    return;
+  }
+  dirty_pages = 0;
+  unflushed_samples = 0;
+}
+
+// Docs are in the header file.
+void metric_history_init(void) {
+  header = (HistoryHeader) { .version = HISTORY_VERSION };
+  HistoryHeader saved;
+  if (persist_read_data(HISTORY_HEADER_PERSIST_KEY, &saved, sizeof(saved)) 
+        != (int) sizeof(saved) || saved.version != HISTORY_VERSION || 
+      saved.count > HISTORY_CAPACITY || saved.head >= HISTORY_CAPACITY) {
+    return;
+  }
+  for (int page = 0; page < HISTORY_PAGE_COUNT; page++) {
+    int expected = sizeof(deltas) / HISTORY_PAGE_COUNT;
+    if (persist_read_data(HISTORY_PAGE_PERSIST_KEY_BASE + page, 
+          deltas[page * HISTORY_PAGE_SAMPLES], expected) != expected) {
+      // Pages are always written before the header that refers to them, so
+      // a missing page never held a live sample.
+      memset(deltas[page * HISTORY_PAGE_SAMPLES], 0, expected);
+    }
+  }
+  header = saved;
+  LOG_DEBUG("Restored %d history samples.", header.count);
+}
+
+// Docs are in the header file.
+void metric_history_deinit(void) {
+  metric_history_flush();
+}
@@ -0,0 +1,109 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module keeps a short on-watch history of New Relic metrics so the 
+ * display can show trends. Samples live in a fixed-size, statically allocated
+ * ring per metric. Each ring stores its oldest value in full and every later
+ * sample as a signed byte delta, in units of a per-ring power-of-two quantum.
+ * The quantum only grows when a change is too big for a byte. Deltas are 
+ * taken against the reconstructed value rather than the raw one, so rounding
+ * error never accumulates.
+ *
+ * There is one sample per minute, so the history's x-axis is time: a sample's
+ * index says how many minutes old it is. Data doesn't arrive every minute 
+ * (polls can be minutes apart, and the phone skips sending unchanged data), 
+ * so a push after a gap first repeats the last values once for every minute
+ * skipped. Those repeats are 0 deltas, so they cost no precision.
+ *
+ * The history is persisted in pages, and a flush only rewrites the pages 
+ * touched since the last one, so it survives face switches without rewriting
+ * the whole buffer every minute.
+ */
+
+#ifndef __METRIC_HISTORY_H__
+#define __METRIC_HISTORY_H__
+
+#include <pebble.h>
+#include "newrelic_protocol.h"
+
+
+/** Number of samples kept per metric: 2 hours, one per minute. */
+#define HISTORY_CAPACITY 120
+
+/** The metrics we keep history for. */
+typedef enum {
+  HISTORY_APDEX,          // apdex score x100
+  HISTORY_ERROR_RATE,     // error rate (%) x100
+  HISTORY_RESPONSE_TIME,  // response time in microseconds
+  HISTORY_THROUGHPUT,     // requests per minute
+  HISTORY_METRIC_COUNT,
+} HistoryMetric;
+
+/**
+ * Receives one sample from metric_history_for_each.
+ *
+ * @param index Index of the sample, 0 being the oldest.
+ * @param value The (approximate) sample value.
+ * @param context The context passed to metric_history_for_each.
+ */
+typedef void (*HistorySampleCallback)(uint16_t index, uint32_t value, 
+    void *context);
+
+/**
+ * Must be called before any other use of this module. Restores the history 
+ * saved by a previous run, if any. The companion destructor is 
+ * metric_history_deinit.
+ */
+void metric_history_init(void);
+
+/**
+ * Saves any unsaved history. Must be called before the app exits.
+ */
+void metric_history_deinit(void);
+
+/**
+ * Records a new set of metrics, after holding the last ones through any 
+ * minutes since the last push, and evicting the oldest samples if the 
+ * history is full. At most one sample is kept per minute; extra samples are
+ * ignored.
+ *
+ * @param metrics The newly received metrics.
+ * @param time When the metrics were received.
+ * @return Number of samples added, at most HISTORY_CAPACITY: 0 if the sample
+ *         was ignored, more than 1 after a gap.
+ */
+uint16_t metric_history_push(const NewrelicMetrics *metrics, time_t time);
+
+/**
+ * @return The number of samples currently held for each metric.
+ */
+uint16_t metric_history_count(void);
+
+/**
+ * Returns the newest value of a metric. Only meaningful if the history is 
+ * not empty.
+ *
+ * @param metric Which metric to read.
+ * @return The (approximate) newest value.
+ */
+uint32_t metric_history_latest(HistoryMetric metric);
+
+/**
+ * Decodes the samples of a metric, oldest first, starting at the given index.
+ *
+ * @param metric Which metric to read.
+ * @param start Index of the first sample to report, 0 being the oldest.
+ * @param callback Called once per sample.
+ * @param context Passed through to the callback.
+ */
+void metric_history_for_each(HistoryMetric metric, uint16_t start, 
+    HistorySampleCallback callback, void *context);
+
+/**
+ * Writes the header and any pages changed since the last flush to persistent
+ * storage. Meant to be run periodically (e.g. as a SchedulerJob) and on exit.
+ */
+void metric_history_flush(void);
+
+
+#endif  // __METRIC_HISTORY_H__
@@ -1,315 +1,691 @@
 #include <pebble.h>
 #include "newrelic_layer.h"
+#include "resource_cache.h"
+#include "persist_keys.h"
+#include "metric_history.h"
+#include "sparkline_layer.h"
+#include "series_layer.h"
+#include "outbox_queue.h"
+#include "scheduler.h"
+#include "number_format.h"
+#include "logging.h"
 
 
-/** Child layers for the New Relic display. */
-static TextLayer *newrelic_app_name_text_layer, *left_data_text_layer, 
-                 *right_data_text_layer, *last_update_text_layer;
-static TextLayer *error_cover_text_layer;
-static Layer *line_layer;
+/** Text shown over the whole display until we have data to show. */
+#define LOADING_MESSAGE \
+  "Loading...\nIf stuck, check watchface settings & Internet connectivity."
+
+/** Version of the persisted snapshot layout. Bump on incompatible changes. */
+#define SNAPSHOT_VERSION 2
+
+/** 
+ * Size of the persisted snapshot header: version, selected app and uint32 
+ * last update time. The packed app table follows it.
+ */
+#define SNAPSHOT_HEADER_SIZE 6
+
+/** Size of the largest persisted snapshot. */
+#define SNAPSHOT_MAX_SIZE (SNAPSHOT_HEADER_SIZE + NEWRELIC_TABLE_MAX_SIZE)
+
+/**
+ * Everything the New Relic display shows. The update proc formats straight 
+ * from here at draw time, so no on-screen strings need to be kept around.
+ */
+typedef struct {
+  NewrelicAppRecord apps[NEWRELIC_MAX_APPS];  // every app the phone sent
+  uint8_t app_count;    // number of valid entries in apps
+  uint8_t selected;     // index of the app on screen
+  bool showing_series;  // true if the primary app's series is on screen
+  bool showing_overview;  // true if the account overview is on screen
+  NewrelicOverview overview;  // as last sent by the phone; flags 0 if never
+  time_t last_update;   // when metrics were last received; 0 if never
+  bool has_metrics;     // false until the first metrics arrive
+  // True while the data on screen is out of date: a snapshot restored from
+  // a previous run, data the phone sent at least a poll interval old, or no
+  // update for STALE_AFTER_POLLS intervals. Cleared by fresh data.
+  bool is_stale;
+  bool is_unsaved;      // true if changed since the snapshot was last saved
+} NewrelicDisplayState;
+
+static NewrelicDisplayState display_state;
+
+/** UPDATE_REQ_KEY values. */
+enum UpdateRequest {
+  UPDATE_REQ_POLL = 1,  // routine poll; the phone may skip unchanged data
+  UPDATE_REQ_FULL = 2,  // we have no fresh data, so send it even if unchanged
+};
+
+/** Data is shown as stale after missing this many polls in a row. */
+#define STALE_AFTER_POLLS 3
+
+/** Flush metric history to persistent storage this often. */
+#define HISTORY_FLUSH_INTERVAL_MINS 15
+
+/** Current poll interval, as last set by the phone. */
+static uint32_t update_interval_mins = 5;
+
+/** 
+ * Why the display is suspended, if it is. While obscured (another app or a
+ * notification covers the face), nobody can see it, so updates are held back
+ * and shown in one repaint once it's back in focus. While obscured or 
+ * disconnected from the phone, polls would go unseen or can only fail, so 
+ * they stop, and one catch-up poll is made when both are over.
+ */
+static struct {
+  bool obscured;
+  bool disconnected;
+} suspension;
+
+/**
+ * What's held back while obscured. Metrics are still decoded into 
+ * display_state as they arrive, each update replacing the last, but only the
+ * newest is shown (and goes into the history) on resume. Series are kept 
+ * packed, since the series layer decodes them as it takes them.
+ */
+static struct {
+  bool metrics;          // display_state has metrics that aren't shown yet
+  bool redraw;           // the display needs a repaint
+  uint8_t series[NEWRELIC_SERIES_MAX_SIZE];
+  size_t series_length;  // 0 if no series is held
+} held;
+
+/** 
+ * Values from the message being processed. Some keys only make sense 
+ * together, so they're collected here and applied once the whole message has
+ * been read. The table points into the inbox, so it's only valid until the
+ * received handler returns.
+ */
+static struct {
+  const uint8_t *table;
+  size_t table_length;
+  int32_t age_secs;
+} inbound;
+
+/** 
+ * Scratch space for save_snapshot and load_snapshot. A whole app table is 
+ * too big to put on the stack.
+ */
+static uint8_t snapshot_buffer[SNAPSHOT_MAX_SIZE];
+
+/** The single custom-drawn layer for the whole New Relic display. */
+static Layer *metrics_layer;
+
+/** Fonts used by the display. */
+static GFont font_16, font_12;
 
 // Docs are in the header file.
 void request_newrelic_update(void) {
-  AppMessageResult send_status;
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "Requesting New Relic data update from phone.");
-  Tuplet update_req = TupletInteger(UPDATE_REQ_KEY, 1);
-  DictionaryIterator *iter;
-  send_status = app_message_outbox_begin(&iter);
-  if (iter == NULL) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, 
-        "Failed to create request for New Relic update! Error: %d", send_status);
-    return;
-  }
-  dict_write_tuplet(iter, &update_req);
-  dict_write_end(iter);
-  send_status = app_message_outbox_send();
-  if (send_status != APP_MSG_OK) {
-    APP_LOG(APP_LOG_LEVEL_ERROR, 
-        "Failed to create request for New Relic update! Error: %d", send_status);
+  LOG_DEBUG("Requesting New Relic data update from phone.");
+  // The phone skips sending data we already have, unless we have nothing
+  // fresh to show. Duplicate requests from the timer, reconnects and init 
+  // merge in the queue.
+  bool need_full = !display_state.has_metrics || display_state.is_stale;
+  outbox_queue_send_int(UPDATE_REQ_KEY, 
+      need_full ? UPDATE_REQ_FULL : UPDATE_REQ_POLL);
+}
+
+/**
+ * Formats the time of the last update the same way as the system clock.
+ *
+ * @param buffer Output buffer. Should be at least 9 bytes.
+ * @param buffer_len Length of the buffer.
+ */
+static void format_last_update(char *buffer, size_t buffer_len) {
+  struct tm *last_update = localtime(&display_state.last_update);
+  if (clock_is_24h_style()) {
+    strftime(buffer, buffer_len, "%R", last_update);
+  } else {
+    strftime(buffer, buffer_len, "%I:%M %p", last_update);
+    if (buffer[0] == '0') memmove(buffer, buffer + 1, buffer_len - 1);
   }
 }
 
 /**
- * A Pebble LayerUpdateProc to redraw our metric divider line.
+ * Draws the 2x2 metric grid with its divider.
  *
- * @param layer The layer that needs to be rendered.
  * @param ctx The destination graphics context to draw into.
+ * @param bounds Bounds of the layer being drawn.
+ * @param metrics The metrics to show.
  */
-static void line_layer_update_callback(Layer *layer, GContext *ctx) {
+static void draw_metric_grid(GContext *ctx, GRect bounds, 
+    const NewrelicMetrics *metrics) {
+  // Formatted on the stack since it's only needed for the duration of the 
+  // draw. Each column is two values with a newline between them:
+  char text[2 * FORMAT_BUFFER_SIZE];
+  char *out = text;
+  out += format_count(out, metrics->throughput);
+  out += format_text(out, "\n");
+  format_duration_us(out, metrics->response_time_us);
+  graphics_draw_text(ctx, text, font_16, 
+      GRect(0, 25, bounds.size.w / 2 - 3, 40), 
+      GTextOverflowModeTrailingEllipsis, GTextAlignmentRight, NULL);
+  out = text;
+  out += format_fixed(out, metrics->apdex_x100, 2, "ap");
+  out += format_text(out, "\n");
+  format_percent_x100(out, metrics->error_rate_x100);
+  graphics_draw_text(ctx, text, font_16, 
+      GRect(bounds.size.w / 2 + 4, 25, bounds.size.w / 2 - 4, 40), 
+      GTextOverflowModeTrailingEllipsis, GTextAlignmentLeft, NULL);
+
+  // The line that divides our metrics:
   graphics_context_set_fill_color(ctx, GColorWhite);
-  graphics_fill_rect(ctx, layer_get_bounds(layer), 0, GCornerNone);
+  graphics_fill_rect(ctx, GRect(bounds.size.w / 2, 31, 1, 26), 0, GCornerNone);
 }
 
 /**
- * Updates the "last update" display timestamp to the current time.
+ * Whether there's an account overview to show.
+ *
+ * @return True if the phone sent any part of one.
  */
-static void set_last_update_to_now(void) {
-  static char last_update_display_data[] = "xx:xx am";
-  clock_copy_time_string(last_update_display_data, sizeof(last_update_display_data));
-  text_layer_set_text(last_update_text_layer, last_update_display_data);
+static bool has_overview(void) {
+  return display_state.overview.flags & (NEWRELIC_OVERVIEW_HAS_VIOLATIONS | 
+      NEWRELIC_OVERVIEW_HAS_HOSTS | NEWRELIC_OVERVIEW_HAS_KEY_TRANSACTION);
 }
 
 /**
- * Converts an (unsigned) int into a human-readable string.
- * Example: 1850000 becomes "1.8m".
+ * Draws the account overview where the metric grid goes: open alert 
+ * violations and hosts on the first line, the slowest key transaction on 
+ * the second. Parts the phone couldn't fetch are left out.
  *
- * @param num The number to make human readable.
- * @param result Buffer to return the human readable string in.
- * @param result_len Length of the result buffer. Should be at least 13 bytes 
- *        (# digits in int + decimal point + unit + \0).
+ * @param ctx The destination graphics context to draw into.
+ * @param bounds Bounds of the layer being drawn.
  */
-static void uint_to_human_readable(unsigned int num, char *result, 
-    int result_len) {
-  const char *units[] = {"", "k", "m", "b"}; // uints cap out in billions
-
-  // No Pebble floats/doubles, so we have to do this via string manipulation.
-  char num_str[11] = "";
-  snprintf(num_str, sizeof(num_str), "%d", num);
-  char *fractional_part = num_str;
-  unsigned int integer_part = num;
-  unsigned int unit = 0;
-
-  // Reduce the left side of the decimal to <1000:
-  for (unit = 0; integer_part >= 1000; unit++) {
-    integer_part /= 1000;
+static void draw_overview(GContext *ctx, GRect bounds) {
+  const NewrelicOverview *overview = &display_state.overview;
+  // Longest is "65535+ alerts, 65.5k hosts\n99.9ms " and the name:
+  char text[34 + NEWRELIC_APP_NAME_SIZE];
+  char *out = text;
+  if (overview->flags & NEWRELIC_OVERVIEW_HAS_VIOLATIONS) {
+    out += format_uint(out, overview->violations);
+    if (overview->flags & NEWRELIC_OVERVIEW_MORE_VIOLATIONS) {
+      out += format_text(out, "+");
+    }
+    out += format_text(out, overview->violations == 1 ? " alert" : " alerts");
+  }
+  if (overview->flags & NEWRELIC_OVERVIEW_HAS_HOSTS) {
+    if (out != text) out += format_text(out, ", ");
+    out += format_count(out, overview->hosts);
+    out += format_text(out, overview->hosts == 1 ? " host" : " hosts");
   }
+  out += format_text(out, "\n");
+  if (overview->flags & NEWRELIC_OVERVIEW_HAS_KEY_TRANSACTION) {
+    out += format_duration_us(out, overview->key_transaction_us);
+    out += format_text(out, " ");
+    format_text(out, overview->key_transaction);
+  }
+  graphics_draw_text(ctx, text, font_16, GRect(0, 25, bounds.size.w, 40), 
+      GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+}
 
-  // How many digits do we have in the integer part?
-  snprintf(result, result_len, "%d", integer_part);
-  if (unit == 0) return;    // just a plain itoa
-  unsigned int num_digits_in_integer_part = strlen(result);
-  fractional_part = num_str + num_digits_in_integer_part;
+/**
+ * Draws the entire New Relic display: app name, the metric grid (unless the
+ * series chart or the overview covers it), the last update time, and the 
+ * loading banner that covers everything until the first data arrives.
+ *
+ * @param layer The layer that needs to be rendered.
+ * @param ctx The destination graphics context to draw into.
+ */
+static void draw_metrics_layer(Layer *layer, GContext *ctx) {
+  GRect bounds = layer_get_bounds(layer);
+  graphics_context_set_text_color(ctx, GColorWhite);
 
-  snprintf(result, result_len, "%d.%.1s%s", integer_part, fractional_part,
-      units[unit]);
+  if (!display_state.has_metrics) {
+    graphics_draw_text(ctx, LOADING_MESSAGE, font_16, bounds, 
+        GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+    return;
+  }
+
+  // The first line contains the app name, truncated since app names can get 
+  // fairly lengthy.
+  const NewrelicAppRecord *app = &display_state.apps[display_state.selected];
+  graphics_draw_text(ctx, 
+      display_state.showing_overview ? "Overview" : app->name, font_16, 
+      GRect(0, 7, bounds.size.w, 20), GTextOverflowModeTrailingEllipsis, 
+      GTextAlignmentCenter, NULL);
+
+  if (display_state.showing_overview) {
+    draw_overview(ctx, bounds);
+  } else if (!display_state.showing_series) {
+    draw_metric_grid(ctx, bounds, &app->metrics);
+  }
+
+  // The "last update" timestamp, right at the bottom. Data restored from a
+  // previous run is flagged until fresh data arrives:
+  char text[16];
+  if (display_state.is_stale) {
+    strcpy(text, "stale ");
+    format_last_update(text + 6, sizeof(text) - 6);
+  } else {
+    format_last_update(text, sizeof(text));
+  }
+  graphics_draw_text(ctx, text, font_12, 
+      GRect(0, bounds.size.h - 12, bounds.size.w, 13), 
+      GTextOverflowModeTrailingEllipsis, GTextAlignmentRight, NULL);
 }
 
 /**
- * Outputs New Relic data to the display. 
+ * A Pebble LayerUpdateProc for the New Relic display. Times the drawing.
  *
- * @param iter A DictionaryIterator for New Relic data to display, where keys 
- *        are defined by the AppMessageKey enum.
+ * @param layer The layer that needs to be rendered.
+ * @param ctx The destination graphics context to draw into.
  */
-static void display_newrelic_data(DictionaryIterator *iter) {
-  // Pebble requires static allocation for any text we want to put on-screen.
-  // To enable updates of one field at a time, we'll also store the previously 
-  // set value for each:
-  static char app_response_time[NEWRELIC_VALUE_FIELD_SIZE] = "";
-  static int32_t app_throughput = 0;  // no uints in PebbleKit JS
-  static char human_readable_app_throughput[NEWRELIC_VALUE_FIELD_SIZE] = "";
-  static char app_error_rate[NEWRELIC_VALUE_FIELD_SIZE] = "";
-  static char app_apdex_score[NEWRELIC_VALUE_FIELD_SIZE] = "";
-  // The final strings to render on-screen:
-  static char final_left_display_data[NEWRELIC_DISPLAY_FIELD_SIZE / 2];
-  static char final_right_display_data[NEWRELIC_DISPLAY_FIELD_SIZE / 2];
-
-  // Try to extract all possible fields from the dict:
-  Tuple *app_response_time_tuple = dict_find(iter, APP_RESPONSE_TIME_KEY);
-  Tuple *app_throughput_tuple = dict_find(iter, APP_THROUGHPUT_KEY);
-  Tuple *app_error_rate_tuple = dict_find(iter, APP_ERROR_RATE_KEY);
-  Tuple *app_apdex_score_tuple = dict_find(iter, APP_APDEX_SCORE_KEY);
-
-  // Grab all provided values:
-  if (app_response_time_tuple) strncpy(app_response_time, 
-      app_response_time_tuple->value->cstring, sizeof(app_response_time) - 1);
-  if (app_throughput_tuple) {
-    app_throughput = app_throughput_tuple->value->int32;
-    uint_to_human_readable(app_throughput, human_readable_app_throughput,
-        sizeof(human_readable_app_throughput));
-  }
-  if (app_error_rate_tuple) strncpy(app_error_rate, 
-      app_error_rate_tuple->value->cstring, sizeof(app_error_rate) - 1);
-  if (app_apdex_score_tuple) strncpy(app_apdex_score,
-      app_apdex_score_tuple->value->cstring, sizeof(app_apdex_score - 1));
+static void metrics_layer_update_callback(Layer *layer, GContext *ctx) {
+  uint32_t started = perf_timer_start();
+  draw_metrics_layer(layer, ctx);
+  perf_timer_stop(PERF_TIMER_DRAW_METRICS, started);
+}
 
-  // Put the data on-screen:
-  snprintf(final_left_display_data, sizeof(final_left_display_data), 
-      "%s\n%sms", human_readable_app_throughput, app_response_time);
-  text_layer_set_text(left_data_text_layer, final_left_display_data);
-  snprintf(final_right_display_data, sizeof(final_right_display_data), 
-      "%sap\n%s%%", app_apdex_score, app_error_rate);
-  text_layer_set_text(right_data_text_layer, final_right_display_data);
+/**
+ * Shows the sub-layers that belong on the current page and hides the rest.
+ * The history sparkline follows the primary app; the series chart and the
+ * overview are pages of their own.
+ */
+static void update_page_visibility(void) {
+  sparkline_layer_set_hidden(!display_state.has_metrics || 
+      display_state.selected != 0 || display_state.showing_overview);
+  series_layer_set_hidden(!display_state.showing_series);
+}
 
-  set_last_update_to_now();
+/**
+ * Whether polls are running: neither obscured nor disconnected.
+ *
+ * @return True if polling.
+ */
+static bool is_polling(void) {
+  return !suspension.obscured && !suspension.disconnected;
+}
 
-  layer_set_hidden((Layer *) error_cover_text_layer, true);
+/**
+ * Redraws the display, or holds the redraw back until it's back in focus.
+ */
+static void redraw(void) {
+  if (suspension.obscured) {
+    held.redraw = true;
+  } else {
+    layer_mark_dirty(metrics_layer);
+  }
+}
 
-  APP_LOG(APP_LOG_LEVEL_INFO, "Updated New Relic data display to:\n%s\n%s", 
-      final_left_display_data, final_right_display_data);
+/**
+ * Adds the displayed metrics of the first (primary) app to its history and
+ * sparkline.
+ */
+static void push_history(void) {
+  uint16_t added = metric_history_push(&display_state.apps[0].metrics, 
+      display_state.last_update);
+  if (added > 0) sparkline_layer_add_latest(added);
 }
 
 /**
- * Outputs the New Relic app name we're monitoring to the display.
+ * Stores new New Relic data for display. The layer is only invalidated when
+ * something visible actually changed, since most polls return the same 
+ * metrics within the same minute. While obscured, the display is left alone
+ * until it's back in focus.
  *
- * @param iter A DictionaryIterator containing the app name (as per the 
- *        AppMessageKey enum).
+ * @param table The packed app table to display (see newrelic_protocol.h).
+ * @param table_length Size of the packed table in bytes.
+ * @param age_secs How long ago the phone fetched the metrics. Data older than
+ *        a poll interval (e.g. served from the phone's cache) shows as stale.
  */
-static void display_newrelic_app_name(DictionaryIterator *iter) {
-  static char app_name[NEWRELIC_VALUE_FIELD_SIZE] = "";
-  Tuple *app_name_tuple = dict_find(iter, APP_NAME_KEY);
-  if (app_name_tuple) strncpy(app_name, app_name_tuple->value->cstring,
-      sizeof(app_name) - 1);
-  text_layer_set_text(newrelic_app_name_text_layer, app_name);
-  APP_LOG(APP_LOG_LEVEL_INFO, "Updated New Relic app name display to: %s", 
-      app_name);
+static void display_newrelic_data(const uint8_t *table, size_t table_length,
+    int32_t age_secs) {
+  // Only the selected app is on screen, so it's all we need to compare:
+  NewrelicAppRecord shown = display_state.apps[display_state.selected];
+  uint8_t app_count;
+  if (!newrelic_table_decode(table, table_length, display_state.apps, 
+        &app_count)) {
+    return;
+  }
+  if (app_count == 0) {
+    LOG_WARNING("Ignoring empty app table.");
+    return;
+  }
+  display_state.app_count = app_count;
+  if (display_state.selected >= app_count) {
+    display_state.selected = 0;
+    display_state.showing_series = false;
+    display_state.showing_overview = false;
+  }
+
+  time_t fetched = time(NULL) - age_secs;
+  bool is_stale = age_secs >= (int32_t) update_interval_mins * 60;
+  const NewrelicAppRecord *app = &display_state.apps[display_state.selected];
+  bool dirty = !display_state.has_metrics || 
+      display_state.is_stale != is_stale ||
+      memcmp(&shown, app, sizeof(shown)) != 0 ||
+      fetched / 60 != display_state.last_update / 60;
+  display_state.last_update = fetched;
+  display_state.has_metrics = true;
+  display_state.is_stale = is_stale;
+  display_state.is_unsaved = true;
+  if (suspension.obscured) {
+    held.metrics = true;
+    held.redraw |= dirty;
+    return;
+  }
+
+  // History and its sparkline follow the first (primary) app only:
+  update_page_visibility();
+  push_history();
+  if (dirty) {
+    layer_mark_dirty(metrics_layer);
+    LOG_INFO("Updated New Relic data display: %d apps, showing %s", 
+        app_count, app->name);
+  }
+}
+
+// Docs are in appkeys.auto.h (AppKeyHandler).
+void newrelic_handle_app_table(const Tuple *tuple) {
+  inbound.table = tuple->value->data;
+  inbound.table_length = tuple->length;
 }
 
 /**
- * A Pebble AppTimerCallback that triggers a New Relic data update and
- * reschedules the timer.
+ * Shows a packed series on the series page.
  *
- * @param mins Schedule another update in this many minutes. (Value gets set 
- *        when the timer for this callback is registered.)
+ * @param data The packed series (see newrelic_protocol.h).
+ * @param length Size of the packed series in bytes.
  */
-static void newrelic_update_timer_handler(void *mins) {
-  APP_LOG(APP_LOG_LEVEL_DEBUG, 
-      "New Relic update timer fired. Rescheduling for %d minutes.", (int) mins);
+static void show_series(const uint8_t *data, size_t length) {
+  if (!series_layer_set_data(data, length)) return;
+  if (display_state.showing_series && !series_layer_has_data()) {
+    // Series mode was turned off on the phone:
+    display_state.showing_series = false;
+    update_page_visibility();
+    layer_mark_dirty(metrics_layer);
+  }
+}
+
+// Docs are in appkeys.auto.h (AppKeyHandler).
+void newrelic_handle_series(const Tuple *tuple) {
+  if (!suspension.obscured) {
+    show_series(tuple->value->data, tuple->length);
+  } else if (tuple->length <= sizeof(held.series)) {
+    memcpy(held.series, tuple->value->data, tuple->length);
+    held.series_length = tuple->length;
+  } else {
+    LOG_WARNING("Ignoring oversized series (%d bytes).", (int) tuple->length);
+  }
+}
+
+// Docs are in appkeys.auto.h (AppKeyHandler).
+void newrelic_handle_overview(const Tuple *tuple) {
+  if (!newrelic_overview_decode(tuple->value->data, tuple->length, 
+        &display_state.overview)) {
+    return;
+  }
+  if (!display_state.showing_overview) return;
+  if (!has_overview()) {
+    // Nothing left to show; back to the primary app:
+    display_state.showing_overview = false;
+    update_page_visibility();
+  }
+  redraw();
+}
+
+// Docs are in appkeys.auto.h (AppKeyHandler).
+void newrelic_handle_data_age(const Tuple *tuple) {
+  inbound.age_secs = tuple->value->int32 > 0 ? tuple->value->int32 : 0;
+}
+
+// Docs are in appkeys.auto.h (AppKeyHandler).
+void newrelic_handle_update_freq(const Tuple *tuple) {
+  int signed_mins = tuple->value->int32;
+  if (signed_mins < 1) {
+    LOG_ERROR("Tried to set update frequency to an invalid value (%d)!", 
+        signed_mins);
+  } else {
+    set_newrelic_update_interval((uint32_t) signed_mins);
+    LOG_INFO("Update frequency now set to %d minutes.", 
+        (int) update_interval_mins);
+  }
+}
+
+/**
+ * A SchedulerJob that triggers a New Relic data update.
+ */
+static void newrelic_poll_job(void) {
+  LOG_DEBUG("New Relic poll job fired.");
   request_newrelic_update();
-  set_newrelic_update_interval((uint32_t) mins);
+}
+
+/**
+ * A SchedulerJob that marks the displayed data stale once several polls in a
+ * row have gone unanswered (phone disconnected, network down, etc.).
+ */
+static void newrelic_stale_check_job(void) {
+  if (!display_state.has_metrics || display_state.is_stale) return;
+  time_t max_age = STALE_AFTER_POLLS * update_interval_mins * 60;
+  if (time(NULL) - display_state.last_update > max_age) {
+    display_state.is_stale = true;
+    redraw();
+  }
 }
 
 // Docs are in the header file.
 void set_newrelic_update_interval(uint32_t mins) {
-  static AppTimer *newrelic_update_timer = NULL;
-  // static to simplify the issue of user config updates requiring loop resets
-  if (newrelic_update_timer != NULL) {
-    app_timer_cancel(newrelic_update_timer);
+  if (mins > NEWRELIC_MAX_UPDATE_INTERVAL_MINS) {
+    mins = NEWRELIC_MAX_UPDATE_INTERVAL_MINS;
+  }
+  update_interval_mins = mins;
+  // While suspended, the new interval takes effect on resume:
+  if (is_polling()) scheduler_schedule(newrelic_poll_job, mins);
+}
+
+/**
+ * Shows whatever was held back while obscured, in one repaint.
+ */
+static void show_held(void) {
+  if (held.series_length > 0) {
+    show_series(held.series, held.series_length);
+    held.series_length = 0;
+  }
+  if (held.metrics) {
+    update_page_visibility();
+    push_history();
+    held.metrics = false;
+  }
+  if (held.redraw) {
+    layer_mark_dirty(metrics_layer);
+    held.redraw = false;
+  }
+}
+
+/**
+ * Applies a change in suspension: shows what was held back once back in 
+ * focus, and stops polls or restarts them with a catch-up poll.
+ *
+ * @param was_polling Whether polls were running before the change.
+ */
+static void update_suspension(bool was_polling) {
+  LOG_DEBUG("Suspension now: obscured %d, disconnected %d.", 
+      suspension.obscured, suspension.disconnected);
+  if (!suspension.obscured) show_held();
+  if (is_polling() == was_polling) return;
+  if (is_polling()) {
+    scheduler_schedule(newrelic_poll_job, update_interval_mins);
+    request_newrelic_update();
+  } else {
+    scheduler_cancel(newrelic_poll_job);
   }
-  newrelic_update_timer = app_timer_register(mins * 60000, 
-      newrelic_update_timer_handler, (void *) mins);
+}
+
+// Docs are in the header file.
+void newrelic_layer_handle_focus(bool in_focus) {
+  bool was_polling = is_polling();
+  suspension.obscured = !in_focus;
+  update_suspension(was_polling);
+}
+
+// Docs are in the header file.
+void newrelic_layer_handle_connection(bool connected) {
+  bool was_polling = is_polling();
+  suspension.disconnected = !connected;
+  update_suspension(was_polling);
 }
 
 // Docs are in the header file.
 void newrelic_app_msg_in_received_handler(DictionaryIterator *iter, 
     void *context) {
-  // All possible incoming message keys:
-  Tuple *update_freq_tuple = dict_find(iter, UPDATE_FREQ_KEY);
-  Tuple *app_name_tuple = dict_find(iter, APP_NAME_KEY);
-  Tuple *app_response_time_tuple = dict_find(iter, APP_RESPONSE_TIME_KEY);
-  Tuple *app_throughput_tuple = dict_find(iter, APP_THROUGHPUT_KEY);
-  Tuple *app_error_rate_tuple = dict_find(iter, APP_ERROR_RATE_KEY);
-  Tuple *app_apdex_score_tuple = dict_find(iter, APP_APDEX_SCORE_KEY);
-
-  // Dispatch:
-  
-  if (app_name_tuple) {
-    display_newrelic_app_name(iter);
+  uint32_t started = perf_timer_start();
+  inbound.table = NULL;
+  inbound.age_secs = 0;
+  for (Tuple *tuple = dict_read_first(iter); tuple != NULL; 
+      tuple = dict_read_next(iter)) {
+    if (tuple->key >= APP_KEY_COUNT || !app_key_handlers[tuple->key]) {
+      LOG_WARNING("Ignoring unexpected App Message key %d.",
+          (int) tuple->key);
+      continue;
+    }
+    if (tuple->type != app_key_types[tuple->key]) {
+      LOG_ERROR("App Message key %d has wrong type %d!",
+          (int) tuple->key, tuple->type);
+      continue;
+    }
+    app_key_handlers[tuple->key](tuple);
+  }
+  if (inbound.table) {
+    uint32_t display_started = perf_timer_start();
+    display_newrelic_data(inbound.table, inbound.table_length, 
+        inbound.age_secs);
+    perf_timer_stop(PERF_TIMER_DISPLAY, display_started);
   }
+  perf_timer_stop(PERF_TIMER_MESSAGE, started);
+}
 
-  if (app_response_time_tuple || app_throughput_tuple || app_error_rate_tuple 
-      || app_apdex_score_tuple) {
-    display_newrelic_data(iter);
+// Docs are in the header file.
+void newrelic_layer_handle_tap(AccelAxisType axis, int32_t direction) {
+  if (!display_state.has_metrics) return;
+  // Pages go: primary app, its series (if any), the overview (if any), then
+  // the other apps.
+  bool on_primary = display_state.selected == 0 && 
+      !display_state.showing_series && !display_state.showing_overview;
+  if (on_primary && series_layer_has_data()) {
+    display_state.showing_series = true;
+  } else if (display_state.selected == 0 && 
+      !display_state.showing_overview && has_overview()) {
+    display_state.showing_series = false;
+    display_state.showing_overview = true;
+  } else if (display_state.app_count > 1 || display_state.showing_series ||
+      display_state.showing_overview) {
+    display_state.showing_series = false;
+    display_state.showing_overview = false;
+    display_state.selected = (display_state.selected + 1) % 
+        display_state.app_count;
+  } else {
+    return;
   }
+  display_state.is_unsaved = true;
+  update_page_visibility();
+  layer_mark_dirty(metrics_layer);
+}
 
-  if (update_freq_tuple) {
-    int signed_mins = update_freq_tuple->value->int32;
-    if (signed_mins < 1) {
-      APP_LOG(APP_LOG_LEVEL_ERROR, 
-          "Tried to set update frequency to an invalid value (%d)!", signed_mins);
-    } else {
-      uint32_t mins = (uint32_t) signed_mins;
-      set_newrelic_update_interval(mins);
-      APP_LOG(APP_LOG_LEVEL_INFO, "Update frequency now set to %d minutes.", 
-          (int) mins);
-    }
+/**
+ * Persists the displayed data so the next launch can show it immediately, 
+ * if it changed since the last save. A full app table is larger than a 
+ * single persist key can hold, so anything past the first key spills into 
+ * SNAPSHOT_OVERFLOW_PERSIST_KEY.
+ */
+static void save_snapshot(void) {
+  if (!display_state.has_metrics || !display_state.is_unsaved) return;
+  uint8_t *snapshot = snapshot_buffer;
+  snapshot[0] = SNAPSHOT_VERSION;
+  snapshot[1] = display_state.selected;
+  uint32_t last_update = (uint32_t) display_state.last_update;
+  memcpy(snapshot + 2, &last_update, sizeof(last_update));
+  size_t length = SNAPSHOT_HEADER_SIZE + newrelic_table_encode(
+      display_state.apps, display_state.app_count, 
+      snapshot + SNAPSHOT_HEADER_SIZE);
+
+  size_t first_length = length < PERSIST_DATA_MAX_LENGTH ? 
+      length : PERSIST_DATA_MAX_LENGTH;
+  int result = persist_write_data(SNAPSHOT_PERSIST_KEY, snapshot, 
+      first_length);
+  if (result >= 0 && length > first_length) {
+    result = persist_write_data(SNAPSHOT_OVERFLOW_PERSIST_KEY, 
+        snapshot + first_length, length - first_length);
+  } else if (result >= 0) {
+    persist_delete(SNAPSHOT_OVERFLOW_PERSIST_KEY);
+  }
+  if (result < 0) {
+    LOG_ERROR("Failed to save snapshot! Error: %d", result);
+  } else {
+    display_state.is_unsaved = false;
   }
+}
 
+/**
+ * Restores the data saved by save_snapshot, if any, and flags it as stale.
+ */
+static void load_snapshot(void) {
+  uint8_t *snapshot = snapshot_buffer;
+  int length = persist_read_data(SNAPSHOT_PERSIST_KEY, snapshot, 
+      PERSIST_DATA_MAX_LENGTH);
+  if (length < SNAPSHOT_HEADER_SIZE || snapshot[0] != SNAPSHOT_VERSION) return;
+  if (length == PERSIST_DATA_MAX_LENGTH && 
+      persist_exists(SNAPSHOT_OVERFLOW_PERSIST_KEY)) {
+    int overflow = persist_read_data(SNAPSHOT_OVERFLOW_PERSIST_KEY, 
+        snapshot + length, sizeof(snapshot_buffer) - length);
+    if (overflow > 0) length += overflow;
+  }
+  uint8_t app_count;
+  if (!newrelic_table_decode(snapshot + SNAPSHOT_HEADER_SIZE, 
+        length - SNAPSHOT_HEADER_SIZE, display_state.apps, &app_count) ||
+      app_count == 0) {
+    return;
+  }
+  display_state.app_count = app_count;
+  display_state.selected = snapshot[1] < app_count ? snapshot[1] : 0;
+  uint32_t last_update;
+  memcpy(&last_update, snapshot + 2, sizeof(last_update));
+  display_state.last_update = (time_t) last_update;
+  display_state.has_metrics = true;
+  display_state.is_stale = true;
+  LOG_DEBUG("Restored snapshot of %d apps.", app_count);
 }
 
 // Docs are in the header file.
 void newrelic_layer_init(Layer *parent_layer) {
+  font_16 = resource_cache_get_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16);
+  font_12 = resource_cache_get_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_12);
+
+  // Show whatever we had last time until the first update arrives:
+  load_snapshot();
+  suspension.obscured = false;
+  suspension.disconnected = !bluetooth_connection_service_peek();
+  held.metrics = held.redraw = false;
+  held.series_length = 0;
+
   GRect bounds = layer_get_bounds(parent_layer);
+  metrics_layer = layer_create(bounds);
+  layer_set_update_proc(metrics_layer, metrics_layer_update_callback);
+  layer_add_child(parent_layer, metrics_layer);
+
+  // Response time trend, bottom left, beside the "last update" timestamp:
+  metric_history_init();
+  scheduler_schedule(metric_history_flush, HISTORY_FLUSH_INTERVAL_MINS);
+  sparkline_layer_init(parent_layer, 
+      GRect(2, bounds.size.h - 12, bounds.size.w / 2 - 6, 11), 
+      HISTORY_RESPONSE_TIME);
+
+  // Time series chart, over the metric grid on its own page:
+  series_layer_init(parent_layer, GRect(0, 27, bounds.size.w, 40));
+  update_page_visibility();
   
-  // The first line contains the app name, which is in its own layer so we can
-  // easily truncate it (because app names can get fairly lengthy).
-  newrelic_app_name_text_layer = text_layer_create((GRect) { 
-      .origin = { 0, 7 },
-      .size = { bounds.size.w, 20 },
-      });
-  text_layer_set_text(newrelic_app_name_text_layer, "Loading...");
-  text_layer_set_text_alignment(newrelic_app_name_text_layer, 
-      GTextAlignmentCenter);
-  text_layer_set_font(newrelic_app_name_text_layer,
-      fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16)));
-  text_layer_set_background_color(newrelic_app_name_text_layer, GColorBlack);
-  text_layer_set_overflow_mode(newrelic_app_name_text_layer, 
-      GTextOverflowModeTrailingEllipsis);
-  text_layer_set_text_color(newrelic_app_name_text_layer, GColorWhite);
-  layer_add_child(parent_layer, 
-      text_layer_get_layer(newrelic_app_name_text_layer));
-  
-  // The main New Relic layer contains all of the New Relic metrics:
-  left_data_text_layer = text_layer_create((GRect) { 
-      .origin = { 0, 25 },
-      .size = { bounds.size.w / 2 - 3, 40 },
-      });
-  text_layer_set_text_alignment(left_data_text_layer, GTextAlignmentRight);
-  text_layer_set_font(left_data_text_layer,
-      fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16)));
-  text_layer_set_background_color(left_data_text_layer, GColorClear);
-  text_layer_set_overflow_mode(left_data_text_layer, 
-      GTextOverflowModeTrailingEllipsis);
-  text_layer_set_text_color(left_data_text_layer, GColorWhite);
-  layer_add_child(parent_layer, text_layer_get_layer(left_data_text_layer));
-  
-  right_data_text_layer = text_layer_create((GRect) { 
-      .origin = { bounds.size.w / 2 + 4, 25 },
-      .size = { bounds.size.w / 2 - 4, 40 },
-      });
-  text_layer_set_text_alignment(right_data_text_layer, GTextAlignmentLeft);
-  text_layer_set_font(right_data_text_layer,
-      fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16)));
-  text_layer_set_background_color(right_data_text_layer, GColorClear);
-  text_layer_set_overflow_mode(right_data_text_layer, 
-      GTextOverflowModeTrailingEllipsis);
-  text_layer_set_text_color(right_data_text_layer, GColorWhite);
-  layer_add_child(parent_layer, text_layer_get_layer(right_data_text_layer));
-  
-  // Create the line that divides our metrics.
-  line_layer = layer_create((GRect) {
-      .origin = { bounds.size.w / 2, 31 },
-      .size = { 1, 26 },
-      });
-  layer_set_update_proc(line_layer, line_layer_update_callback);
-  layer_add_child(parent_layer, line_layer);
-
-  // To display a "last update" timestamp, we create a child layer superimposed 
-  // on the main New Relic layer, right at the bottom. Our main layer text 
-  // arrangement leaves space for it.
-  last_update_text_layer = text_layer_create((GRect) { 
-      .origin = { 0, bounds.size.h - 12 },
-      .size = { bounds.size.w, 13 },
-      });
-  text_layer_set_text_alignment(last_update_text_layer, GTextAlignmentRight);
-  text_layer_set_font(last_update_text_layer, fonts_load_custom_font(
-        resource_get_handle(RESOURCE_ID_FONT_SIGNIKA_REGULAR_12)));
-  text_layer_set_background_color(last_update_text_layer, GColorClear);
-  text_layer_set_text_color(last_update_text_layer, GColorWhite);
-  layer_add_child(parent_layer, text_layer_get_layer(last_update_text_layer));
-  
-  // This layer covers the entire New Relic display area to display
-  // errors/alerts. Currently only used for first-time loads.
-  error_cover_text_layer = text_layer_create((GRect) {
-      .origin = { 0, 0 },
-      .size = { bounds.size.w, bounds.size.h },
-      });
-  text_layer_set_text_alignment(error_cover_text_layer, GTextAlignmentCenter);
-  text_layer_set_font(error_cover_text_layer,
-      fonts_load_custom_font(resource_get_handle(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16)));
-  text_layer_set_background_color(error_cover_text_layer, GColorBlack);
-  text_layer_set_overflow_mode(error_cover_text_layer, GTextOverflowModeWordWrap);
-  text_layer_set_text_color(error_cover_text_layer, GColorWhite);
-  text_layer_set_text(error_cover_text_layer, 
-      "Loading...\nIf stuck, check watchface settings & Internet connectivity.");
-  layer_add_child(parent_layer, text_layer_get_layer(error_cover_text_layer));
-  
-  request_newrelic_update();    // our first data fetch
+  scheduler_schedule(newrelic_stale_check_job, 1);
+  if (is_polling()) request_newrelic_update();    // our first data fetch
 }
 
 // Docs are in the header file.
 void newrelic_layer_deinit(void) {
-  text_layer_destroy(left_data_text_layer);
-  text_layer_destroy(last_update_text_layer);
-  layer_destroy(line_layer);
-  text_layer_destroy(error_cover_text_layer);
+  scheduler_cancel(newrelic_poll_job);
+  scheduler_cancel(newrelic_stale_check_job);
+  scheduler_cancel(metric_history_flush);
+  save_snapshot();
+  metric_history_deinit();
+  sparkline_layer_deinit();
+  series_layer_deinit();
+  layer_destroy(metrics_layer);
+  resource_cache_release_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_16);
+  resource_cache_release_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_12);
 }
@@ -10,32 +10,33 @@
 #define __NEWRELIC_LAYER_H__
 
 #include <pebble.h>
+#include "newrelic_protocol.h"
+#include "transfer.h"
+#include "perf_stats.h"
+#include "appkeys.auto.h"
 
 
-/** Max string length of a New Relic metric value. */
-#define NEWRELIC_VALUE_FIELD_SIZE 24
-
-/** Max length of the final New Relic text printed to the screen. */
-#define NEWRELIC_DISPLAY_FIELD_SIZE (NEWRELIC_VALUE_FIELD_SIZE * 4 + 10)
-// We have 4 data fields, and the +10 is for labels/spacing.
+/** 
+ * Serialized size of an App Message dictionary with the given number of tuples
+ * and total value bytes (1 byte count header + 7 bytes header per tuple).
+ */
+#define APP_MESSAGE_DICT_SIZE(tuples, value_bytes) \
+  (1 + (tuples) * 7 + (value_bytes))
 
 /**
- * These are the key mappings for KV pairs passed from JS by App Message.
- * They must be kept in sync with the phone JS side via appinfo.json.
+ * Largest message the phone sends us in one piece: a transfer chunk. Bigger
+ * messages are split into chunks (see transfer.h). The biggest of those, a 
+ * full app table + data age (APP_MESSAGE_DICT_SIZE(2, 
+ * NEWRELIC_TABLE_MAX_SIZE + 4)), must fit in TRANSFER_MAX_SIZE.
  */
-enum AppMessageKey {
-  // Key:                     // Value:
-  UPDATE_REQ_KEY = 0,         // int32 - non-0 is a request msg for new data
-  UPDATE_FREQ_KEY = 1,        // int32 - Instruction to fetch new New Relic 
-                              //         data every this many minutes
-  APP_NAME_KEY = 2,           // cstring - New Relic app name we're monitoring
-  APP_RESPONSE_TIME_KEY = 3,  // cstring - New Relic app response time
-                              //           a string since Pebble has no floats
-  APP_THROUGHPUT_KEY = 4,     // int32 - New Relic app RPM 
-                              //         (can't send uints from JS App Messages)
-  APP_ERROR_RATE_KEY = 5,     // int32 - New Relic app error rate (%)
-  APP_APDEX_SCORE_KEY = 6,    // cstring - New Relic apdex score for our app
-};
+#define NEWRELIC_INBOX_SIZE APP_MESSAGE_DICT_SIZE(1, \
+    TRANSFER_HEADER_SIZE + TRANSFER_CHUNK_SIZE)
+
+/** 
+ * Largest message we send the phone: a stats snapshot. Everything else is a
+ * single int32.
+ */
+#define NEWRELIC_OUTBOX_SIZE APP_MESSAGE_DICT_SIZE(1, PERF_STATS_SIZE)
 
 /**
  * Sends an App Message to the phone to request an update of New Relic data.
@@ -43,23 +44,62 @@ enum AppMessageKey {
 void request_newrelic_update(void);
 
 /**
- * Schedule a New Relic data poll on a loop with the given frequency.
- * Repeated invocations overwrite previous timers.
+ * Longest update interval we accept, in minutes: a day. The phone clamps to
+ * the same limit (Options.MAX_FREQ); the scheduler's period is a uint16.
+ */
+#define NEWRELIC_MAX_UPDATE_INTERVAL_MINS 1440
+
+/**
+ * Schedule a New Relic data poll on a loop with the given frequency, run from
+ * the minute tick (see scheduler.h). Repeated invocations only change the 
+ * period; polls stay aligned to the clock.
  *
- * @param mins Update New Relic data every this many minutes.
+ * @param mins Update New Relic data every this many minutes, clamped to 
+ *        NEWRELIC_MAX_UPDATE_INTERVAL_MINS.
  */
 void set_newrelic_update_interval(uint32_t mins);
 
 /**
  * A Pebble AppMessageInboxReceived (incoming App Message) handler that
  * processes New Relic updates from the phone and updates the watch display.
+ * Walks the message once, passing each tuple to its handler from the 
+ * generated app_key_handlers table, then applies the decoded update.
  *
  * @param iter Dictionary iterator containing message key-value pairs. Keys are
- *        defined in the AppMessageKey enum.
+ *        defined in the AppMessageKey enum (generated from appkeys.json).
  * @param context Application data as specified when registering the callback.
  *        Unused.
  */
-void newrelic_app_msg_in_received_handler(DictionaryIterator *iter, void *context);
+void newrelic_app_msg_in_received_handler(DictionaryIterator *iter, 
+    void *context);
+
+/**
+ * A Pebble AccelTapHandler that switches the display to the next monitored
+ * app. Watchfaces get no buttons, so a flick of the wrist is our only input.
+ * Only redraws; the data for every app is already on the watch.
+ *
+ * @param axis The axis the tap was detected on. Unused.
+ * @param direction The direction of the tap. Unused.
+ */
+void newrelic_layer_handle_tap(AccelAxisType axis, int32_t direction);
+
+/**
+ * A Pebble AppFocusHandler. While another app or a notification covers the
+ * face, polls stop and updates are held back. Back in focus, the newest 
+ * update is shown in one repaint, and one catch-up poll is made.
+ *
+ * @param in_focus True if the face is in focus again, false if it lost it.
+ */
+void newrelic_layer_handle_focus(bool in_focus);
+
+/**
+ * A Pebble BluetoothConnectionHandler. Polls stop while the phone is 
+ * disconnected, since they can only fail, and one catch-up poll is made on
+ * reconnection.
+ *
+ * @param connected True on BT connection, false on disconnection.
+ */
+void newrelic_layer_handle_connection(bool connected);
 
 /**
  * Must be called to initialize the New Relic display layer before any other
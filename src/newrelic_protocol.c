@@ -0,0 +1,197 @@
+#include <pebble.h>
+#include "newrelic_protocol.h"
+#include "logging.h"
+
+
+/** Byte offsets of the metric fields of an app table record. */
+enum MetricsOffset {
+  APDEX_OFFSET = 0,
+  ERROR_RATE_OFFSET = 2,
+  RESPONSE_TIME_OFFSET = 4,
+  THROUGHPUT_OFFSET = 8,
+};
+
+/** Byte offsets of the app table header fields. */
+enum TableOffset {
+  TABLE_VERSION_OFFSET = 0,
+  TABLE_COUNT_OFFSET = 1,
+  TABLE_RECORDS_OFFSET = 2,
+};
+
+/** Byte offsets of the series header fields. */
+enum SeriesOffset {
+  SERIES_VERSION_OFFSET = 0,
+  SERIES_METRIC_OFFSET = 1,
+  SERIES_MIN_OFFSET = 2,
+  SERIES_MAX_OFFSET = 6,
+  SERIES_WINDOW_OFFSET = 10,
+  SERIES_COUNT_OFFSET = 12,
+  SERIES_POINTS_OFFSET = 13,
+};
+
+/** Byte offsets of the overview fields. */
+enum OverviewOffset {
+  OVERVIEW_VERSION_OFFSET = 0,
+  OVERVIEW_FLAGS_OFFSET = 1,
+  OVERVIEW_VIOLATIONS_OFFSET = 2,
+  OVERVIEW_HOSTS_OFFSET = 4,
+  OVERVIEW_KEY_TRANSACTION_US_OFFSET = 6,
+  OVERVIEW_NAME_LENGTH_OFFSET = 10,
+  OVERVIEW_NAME_OFFSET = 11,
+};
+
+/**
+ * Reads a little-endian uint16 from an arbitrarily aligned buffer.
+ */
+static uint16_t read_uint16(const uint8_t *data) {
+  return (uint16_t) (data[0] | (data[1] << 8));
+}
+
+/**
+ * Reads a little-endian uint32 from an arbitrarily aligned buffer.
+ */
+static uint32_t read_uint32(const uint8_t *data) {
+  return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | 
+      ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+/**
+ * Writes a little-endian uint16 to an arbitrarily aligned buffer.
+ */
+static void write_uint16(uint8_t *data, uint16_t value) {
+  data[0] = value & 0xFF;
+  data[1] = value >> 8;
+}
+
+/**
+ * Writes a little-endian uint32 to an arbitrarily aligned buffer.
+ */
+static void write_uint32(uint8_t *data, uint32_t value) {
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+  data[2] = (value >> 16) & 0xFF;
+  data[3] = value >> 24;
+}
+
+/**
+ * Reads the metric fields of an app table record.
+ */
+static void read_fields(const uint8_t *data, NewrelicMetrics *metrics) {
+  metrics->apdex_x100 = read_uint16(data + APDEX_OFFSET);
+  metrics->error_rate_x100 = read_uint16(data + ERROR_RATE_OFFSET);
+  metrics->response_time_us = read_uint32(data + RESPONSE_TIME_OFFSET);
+  metrics->throughput = read_uint32(data + THROUGHPUT_OFFSET);
+}
+
+/**
+ * Writes the metric fields of an app table record.
+ */
+static void write_fields(uint8_t *data, const NewrelicMetrics *metrics) {
+  write_uint16(data + APDEX_OFFSET, metrics->apdex_x100);
+  write_uint16(data + ERROR_RATE_OFFSET, metrics->error_rate_x100);
+  write_uint32(data + RESPONSE_TIME_OFFSET, metrics->response_time_us);
+  write_uint32(data + THROUGHPUT_OFFSET, metrics->throughput);
+}
+
+// Docs are in the header file.
+bool newrelic_table_decode(const uint8_t *data, size_t length, 
+    NewrelicAppRecord *apps, uint8_t *count) {
+  if (length < TABLE_RECORDS_OFFSET || 
+      data[TABLE_VERSION_OFFSET] != NEWRELIC_TABLE_VERSION) {
+    LOG_ERROR("Unsupported app table payload!");
+    return false;
+  }
+  uint8_t num_apps = data[TABLE_COUNT_OFFSET];
+  if (num_apps > NEWRELIC_MAX_APPS) {
+    LOG_ERROR("App table has too many apps (%d)!", num_apps);
+    return false;
+  }
+
+  // Check every record fits before touching the output:
+  size_t offset = TABLE_RECORDS_OFFSET;
+  for (uint8_t i = 0; i < num_apps; i++) {
+    if (offset >= length || data[offset] >= NEWRELIC_APP_NAME_SIZE ||
+        offset + 1 + data[offset] + NEWRELIC_METRICS_FIELDS_SIZE > length) {
+      LOG_ERROR("App table record %d is malformed!", i);
+      return false;
+    }
+    offset += 1 + data[offset] + NEWRELIC_METRICS_FIELDS_SIZE;
+  }
+
+  offset = TABLE_RECORDS_OFFSET;
+  for (uint8_t i = 0; i < num_apps; i++) {
+    size_t name_len = data[offset++];
+    memcpy(apps[i].name, data + offset, name_len);
+    apps[i].name[name_len] = '\0';
+    offset += name_len;
+    read_fields(data + offset, &apps[i].metrics);
+    offset += NEWRELIC_METRICS_FIELDS_SIZE;
+  }
+  *count = num_apps;
+  return true;
+}
+
+// Docs are in the header file.
+size_t newrelic_table_encode(const NewrelicAppRecord *apps, uint8_t count, 
+    uint8_t *data) {
+  data[TABLE_VERSION_OFFSET] = NEWRELIC_TABLE_VERSION;
+  data[TABLE_COUNT_OFFSET] = count;
+  size_t offset = TABLE_RECORDS_OFFSET;
+  for (uint8_t i = 0; i < count; i++) {
+    size_t name_len = strlen(apps[i].name);
+    data[offset++] = name_len;
+    memcpy(data + offset, apps[i].name, name_len);
+    offset += name_len;
+    write_fields(data + offset, &apps[i].metrics);
+    offset += NEWRELIC_METRICS_FIELDS_SIZE;
+  }
+  return offset;
+}
+
+// Docs are in the header file.
+bool newrelic_series_decode(const uint8_t *data, size_t length, 
+    NewrelicSeries *series) {
+  if (length < SERIES_POINTS_OFFSET || 
+      data[SERIES_VERSION_OFFSET] != NEWRELIC_SERIES_VERSION) {
+    LOG_ERROR("Unsupported series payload!");
+    return false;
+  }
+  uint8_t count = data[SERIES_COUNT_OFFSET];
+  if (count > NEWRELIC_SERIES_MAX_POINTS || 
+      (size_t) SERIES_POINTS_OFFSET + count > length ||
+      data[SERIES_METRIC_OFFSET] > NEWRELIC_SERIES_THROUGHPUT) {
+    LOG_ERROR("Series payload is malformed!");
+    return false;
+  }
+  series->metric = data[SERIES_METRIC_OFFSET];
+  series->min = read_uint32(data + SERIES_MIN_OFFSET);
+  series->max = read_uint32(data + SERIES_MAX_OFFSET);
+  series->window_mins = read_uint16(data + SERIES_WINDOW_OFFSET);
+  series->count = count;
+  memcpy(series->points, data + SERIES_POINTS_OFFSET, count);
+  return true;
+}
+
+// Docs are in the header file.
+bool newrelic_overview_decode(const uint8_t *data, size_t length, 
+    NewrelicOverview *overview) {
+  if (length < OVERVIEW_NAME_OFFSET || 
+      data[OVERVIEW_VERSION_OFFSET] != NEWRELIC_OVERVIEW_VERSION) {
+    LOG_ERROR("Unsupported overview payload!");
+    return false;
+  }
+  size_t name_len = data[OVERVIEW_NAME_LENGTH_OFFSET];
+  if (name_len >= NEWRELIC_APP_NAME_SIZE || 
+      OVERVIEW_NAME_OFFSET + name_len > length) {
+    LOG_ERROR("Overview payload is malformed!");
+    return false;
+  }
+  overview->flags = data[OVERVIEW_FLAGS_OFFSET];
+  overview->violations = read_uint16(data + OVERVIEW_VIOLATIONS_OFFSET);
+  overview->hosts = read_uint16(data + OVERVIEW_HOSTS_OFFSET);
+  overview->key_transaction_us = 
+      read_uint32(data + OVERVIEW_KEY_TRANSACTION_US_OFFSET);
+  memcpy(overview->key_transaction, data + OVERVIEW_NAME_OFFSET, name_len);
+  overview->key_transaction[name_len] = '\0';
+  return true;
+}
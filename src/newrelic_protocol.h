@@ -0,0 +1,203 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module defines the binary wire format used to ship New Relic data
+ * from the phone to the watch. Pebble has no floats, so every metric travels
+ * as a scaled integer inside packed byte array tuples. The phone JS has a 
+ * matching codec for each payload (named below), and both sides must be 
+ * updated together whenever a layout changes. All multi-byte fields are 
+ * little-endian.
+ *
+ * The apps travel together as one app table byte array, so that a whole poll
+ * reaches the watch in a single App Message (encodeAppTable/decodeAppTable 
+ * on the phone):
+ *
+ *   Offset  Size  Field
+ *   0       1     Table format version (NEWRELIC_TABLE_VERSION)
+ *   1       1     Number of app records that follow
+ *   2       ...   Records: 1 byte name length, the UTF-8 app name without 
+ *                 its \0, then the app's metric fields
+ *
+ * Metric fields of a record (encodeMetricFields/decodeMetricFields on the 
+ * phone):
+ *
+ *   Offset  Size  Field
+ *   0       2     Apdex score x100 (0.94 -> 94)
+ *   2       2     Error rate (%) x100 (0.25% -> 25)
+ *   4       4     Response time in microseconds
+ *   8       4     Throughput in requests per minute
+ *
+ * An optional time series of one metric for the primary app travels in its 
+ * own byte array. The phone downsamples it to at most one point per screen
+ * column and quantizes each point to a byte, so its size doesn't depend on 
+ * the length of the time window (encodeSeries on the phone):
+ *
+ *   Offset  Size  Field
+ *   0       1     Series format version (NEWRELIC_SERIES_VERSION)
+ *   1       1     Metric (NewrelicSeriesMetric)
+ *   2       4     Smallest value, in the metric's units
+ *   6       4     Largest value, in the metric's units
+ *   10      2     Length of the time window in minutes
+ *   12      1     Number of points that follow (0 clears the series)
+ *   13      ...   Points, oldest first: 0 is the smallest value, 255 the 
+ *                 largest, linear in between
+ *
+ * An account overview, fetched from other New Relic endpoints at the same 
+ * time as the apps, travels in the same message as the app table 
+ * (encodeOverview on the phone). Flags (NewrelicOverviewFlag) tell which 
+ * fields the phone has; the others are 0:
+ *
+ *   Offset  Size  Field
+ *   0       1     Overview format version (NEWRELIC_OVERVIEW_VERSION)
+ *   1       1     Flags
+ *   2       2     Number of open alert violations
+ *   4       2     Number of hosts running the monitored apps
+ *   6       4     Response time of the slowest key transaction, in 
+ *                 microseconds
+ *   10      1     Length of its name
+ *   11      ...   Its UTF-8 name, without its \0
+ */
+
+#ifndef __NEWRELIC_PROTOCOL_H__
+#define __NEWRELIC_PROTOCOL_H__
+
+#include <pebble.h>
+
+
+/** Size in bytes of the metric fields of an app table record. */
+#define NEWRELIC_METRICS_FIELDS_SIZE 12
+
+/** Version of the packed app table layout. Bump on any incompatible change. */
+#define NEWRELIC_TABLE_VERSION 1
+
+/** Max number of apps in an app table. */
+#define NEWRELIC_MAX_APPS 12
+
+/** Max size of an app name, including its \0. */
+#define NEWRELIC_APP_NAME_SIZE 24
+
+/** Largest possible packed app table. */
+#define NEWRELIC_TABLE_MAX_SIZE (2 + NEWRELIC_MAX_APPS * \
+    (NEWRELIC_APP_NAME_SIZE + NEWRELIC_METRICS_FIELDS_SIZE))
+// Each record: length byte + name without \0 + metric fields.
+
+/** Version of the packed series layout. Bump on any incompatible change. */
+#define NEWRELIC_SERIES_VERSION 1
+
+/** Max number of points in a series: one per column of the screen. */
+#define NEWRELIC_SERIES_MAX_POINTS 144
+
+/** Largest possible packed series. */
+#define NEWRELIC_SERIES_MAX_SIZE (13 + NEWRELIC_SERIES_MAX_POINTS)
+
+/** Version of the packed overview layout. Bump on any incompatible change. */
+#define NEWRELIC_OVERVIEW_VERSION 1
+
+/** Largest possible packed overview. */
+#define NEWRELIC_OVERVIEW_MAX_SIZE (11 + NEWRELIC_APP_NAME_SIZE - 1)
+
+/** Overview flags: which fields the phone could fetch. */
+typedef enum {
+  NEWRELIC_OVERVIEW_HAS_VIOLATIONS = 1 << 0,
+  NEWRELIC_OVERVIEW_MORE_VIOLATIONS = 1 << 1,  // more are open than counted
+  NEWRELIC_OVERVIEW_HAS_HOSTS = 1 << 2,
+  NEWRELIC_OVERVIEW_HAS_KEY_TRANSACTION = 1 << 3,
+} NewrelicOverviewFlag;
+
+/** Metrics a series can chart, with the units of their values. */
+typedef enum {
+  NEWRELIC_SERIES_RESPONSE_TIME = 0,  // microseconds
+  NEWRELIC_SERIES_THROUGHPUT = 1,     // requests per minute
+} NewrelicSeriesMetric;
+
+/**
+ * One decoded set of New Relic app metrics, in fixed-point form.
+ */
+typedef struct {
+  uint16_t apdex_x100;        // apdex score x100
+  uint16_t error_rate_x100;   // error rate (%) x100
+  uint32_t response_time_us;  // response time in microseconds
+  uint32_t throughput;        // requests per minute
+} NewrelicMetrics;
+
+/**
+ * One app's entry in an app table.
+ */
+typedef struct {
+  char name[NEWRELIC_APP_NAME_SIZE];
+  NewrelicMetrics metrics;
+} NewrelicAppRecord;
+
+/**
+ * A decoded time series. Point values are quantized; see the layout above.
+ */
+typedef struct {
+  NewrelicSeriesMetric metric;
+  uint32_t min;           // value of point 0
+  uint32_t max;           // value of point 255
+  uint16_t window_mins;   // time span covered by the points
+  uint8_t count;          // number of valid points
+  uint8_t points[NEWRELIC_SERIES_MAX_POINTS];
+} NewrelicSeries;
+
+/**
+ * A decoded account overview.
+ */
+typedef struct {
+  uint8_t flags;                // NewrelicOverviewFlag bits
+  uint16_t violations;          // open alert violations
+  uint16_t hosts;               // hosts running the monitored apps
+  uint32_t key_transaction_us;  // response time of the slowest key transaction
+  char key_transaction[NEWRELIC_APP_NAME_SIZE];  // its name
+} NewrelicOverview;
+
+/**
+ * Decodes a packed app table as received from the phone. The whole table is
+ * validated before anything is written, so apps is left untouched on error.
+ *
+ * @param data The packed bytes.
+ * @param length Number of bytes available at data.
+ * @param apps Output for the decoded records. Must hold NEWRELIC_MAX_APPS.
+ * @param count Output for the number of records decoded.
+ * @return True if the data was a complete table in a version we understand.
+ */
+bool newrelic_table_decode(const uint8_t *data, size_t length, 
+    NewrelicAppRecord *apps, uint8_t *count);
+
+/**
+ * Encodes app records into the packed app table format. The inverse of 
+ * newrelic_table_decode.
+ *
+ * @param apps The records to encode.
+ * @param count Number of records, at most NEWRELIC_MAX_APPS.
+ * @param data Output buffer of at least NEWRELIC_TABLE_MAX_SIZE bytes.
+ * @return The number of bytes written.
+ */
+size_t newrelic_table_encode(const NewrelicAppRecord *apps, uint8_t count, 
+    uint8_t *data);
+
+/**
+ * Decodes a packed time series as received from the phone.
+ *
+ * @param data The packed bytes.
+ * @param length Number of bytes available at data.
+ * @param series Output for the decoded series. Only written on success.
+ * @return True if the data was a complete series in a version we understand.
+ */
+bool newrelic_series_decode(const uint8_t *data, size_t length, 
+    NewrelicSeries *series);
+
+/**
+ * Decodes a packed account overview as received from the phone.
+ *
+ * @param data The packed bytes.
+ * @param length Number of bytes available at data.
+ * @param overview Output for the decoded overview. Only written on success.
+ * @return True if the data was a complete overview in a version we 
+ *         understand.
+ */
+bool newrelic_overview_decode(const uint8_t *data, size_t length, 
+    NewrelicOverview *overview);
+
+
+#endif  // __NEWRELIC_PROTOCOL_H__
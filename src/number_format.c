@@ -0,0 +1,150 @@
+#include <pebble.h>
+#include "number_format.h"
+
+
+/** Largest power of ten a uint32 holds. */
+#define MAX_POWER_OF_TEN 9
+
+static const uint32_t powers_of_ten[MAX_POWER_OF_TEN + 1] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+/** A unit of a compact format. */
+typedef struct {
+  uint8_t exponent;    // value / 10^exponent is the number in this unit
+  const char *suffix;
+} FormatUnit;
+
+/** Units of each compact format, smallest first. */
+static const FormatUnit count_units[] = {
+  { 0, "" }, { 3, "k" }, { 6, "m" }, { 9, "b" },
+};
+static const FormatUnit duration_units[] = {
+  { 3, "ms" }, { 6, "s" },
+};
+static const FormatUnit percent_units[] = {
+  { 2, "%" },
+};
+
+#define UNIT_COUNT(units) (sizeof(units) / sizeof(units[0]))
+
+/**
+ * Counts the decimal digits of a number.
+ *
+ * @param value The number.
+ * @return Number of digits; 1 for 0.
+ */
+static uint8_t count_digits(uint32_t value) {
+  uint8_t digits = 1;
+  while (digits <= MAX_POWER_OF_TEN && value >= powers_of_ten[digits]) {
+    digits++;
+  }
+  return digits;
+}
+
+/**
+ * Divides by a power of ten, rounding half up. Doesn't overflow, even for
+ * values near UINT32_MAX.
+ *
+ * @param value The number to divide.
+ * @param exponent The power of ten to divide by.
+ * @return The rounded quotient.
+ */
+static uint32_t divide_rounded(uint32_t value, uint8_t exponent) {
+  if (exponent == 0) return value;
+  uint32_t divisor = powers_of_ten[exponent];
+  return value / divisor + (value % divisor >= divisor / 2);
+}
+
+/**
+ * Writes a number in compact form: in the largest unit it reaches, with as
+ * many decimals as fit in FORMAT_SIGNIFICANT_DIGITS significant digits.
+ *
+ * @param buffer Output buffer of at least FORMAT_BUFFER_SIZE bytes.
+ * @param value The number, in the base unit of the format.
+ * @param units The format's units, smallest first.
+ * @param unit_count Number of units.
+ * @return Length of the string written.
+ */
+static size_t format_compact(char *buffer, uint32_t value,
+    const FormatUnit *units, uint8_t unit_count) {
+  uint8_t unit = 0;
+  while (unit + 1 < unit_count &&
+      value >= powers_of_ten[units[unit + 1].exponent]) {
+    unit++;
+  }
+
+  for (;;) {
+    uint8_t exponent = units[unit].exponent;
+    uint8_t digits = count_digits(value);
+    uint8_t integer_digits = digits > exponent ? digits - exponent : 1;
+    uint8_t decimals = 0;
+    if (integer_digits < FORMAT_SIGNIFICANT_DIGITS) {
+      decimals = FORMAT_SIGNIFICANT_DIGITS - integer_digits;
+      if (decimals > exponent) decimals = exponent;
+    }
+    uint32_t rounded = divide_rounded(value, exponent - decimals);
+
+    // Rounding up can add a digit (9.996 to 10.00). The new last digit is a
+    // 0, so dropping it is exact:
+    if (decimals > 0 &&
+        rounded >= powers_of_ten[FORMAT_SIGNIFICANT_DIGITS]) {
+      rounded /= 10;
+      decimals--;
+    }
+    // It can also carry into the next unit (999.6k to 1000k), which then
+    // shows it as 1.00:
+    if (unit + 1 < unit_count && rounded >=
+        powers_of_ten[decimals + units[unit + 1].exponent - exponent]) {
+      unit++;
+      continue;
+    }
+    return format_fixed(buffer, rounded, decimals, units[unit].suffix);
+  }
+}
+
+// Docs are in the header file.
+size_t format_text(char *buffer, const char *text) {
+  size_t length = strlen(text);
+  memcpy(buffer, text, length + 1);
+  return length;
+}
+
+// Docs are in the header file.
+size_t format_uint(char *buffer, uint32_t value) {
+  return format_fixed(buffer, value, 0, "");
+}
+
+// Docs are in the header file.
+size_t format_fixed(char *buffer, uint32_t value, uint8_t decimals,
+    const char *suffix) {
+  uint8_t digits = count_digits(value);
+  if (digits <= decimals) digits = decimals + 1;  // pad to a leading "0."
+
+  // Write the digits backwards from the end of the number:
+  char *end = buffer + digits + (decimals > 0);
+  char *out = end;
+  for (uint8_t i = 0; i < digits; i++) {
+    if (decimals > 0 && i == decimals) *--out = '.';
+    *--out = '0' + value % 10;
+    value /= 10;
+  }
+  return (end - buffer) + format_text(end, suffix);
+}
+
+// Docs are in the header file.
+size_t format_count(char *buffer, uint32_t value) {
+  return format_compact(buffer, value, count_units, UNIT_COUNT(count_units));
+}
+
+// Docs are in the header file.
+size_t format_duration_us(char *buffer, uint32_t us) {
+  return format_compact(buffer, us, duration_units,
+      UNIT_COUNT(duration_units));
+}
+
+// Docs are in the header file.
+size_t format_percent_x100(char *buffer, uint32_t value_x100) {
+  return format_compact(buffer, value_x100, percent_units,
+      UNIT_COUNT(percent_units));
+}
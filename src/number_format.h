@@ -0,0 +1,105 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module turns the integer metrics we get from the phone into short
+ * display strings, without the printf family: no format string parsing, no
+ * allocation and no floating point, just integer division on caller-provided
+ * buffers. Values are fixed-point integers (e.g. microseconds or hundredths
+ * of a percent), and the compact formats pick a unit and keep
+ * FORMAT_SIGNIFICANT_DIGITS significant digits, rounding half up:
+ *
+ *   format_count        999, 1.85k, 12.3k, 999k, 1.00m, 4.29b
+ *   format_duration_us  0.40ms, 120ms, 1.00s, 12.0s
+ *   format_percent_x100 0.05%, 1.23%, 12.3%, 100%
+ *
+ * Every function returns the length of what it wrote, not counting the
+ * terminating \0, so strings can be built up piece by piece:
+ *
+ *   char *out = text;
+ *   out += format_count(out, throughput);
+ *   out += format_text(out, "rpm");
+ *
+ * host/bench.c checks every format against a printf-based reference.
+ */
+
+#ifndef __NUMBER_FORMAT_H__
+#define __NUMBER_FORMAT_H__
+
+#include <pebble.h>
+
+
+/** Significant digits kept by the compact formats. */
+#define FORMAT_SIGNIFICANT_DIGITS 3
+
+/**
+ * Longest string the compact formats produce, e.g. "99.9ms". Values too big
+ * for the largest unit just get more integer digits ("4295s"), still within
+ * this.
+ */
+#define FORMAT_COMPACT_MAX_LENGTH 6
+
+/** Buffer size that fits anything a single call writes, including the \0. */
+#define FORMAT_BUFFER_SIZE 16
+
+/**
+ * Copies a string, for building up text between numbers.
+ *
+ * @param buffer Output buffer, big enough for text.
+ * @param text The string to copy.
+ * @return Length of text.
+ */
+size_t format_text(char *buffer, const char *text);
+
+/**
+ * Writes an unsigned integer in full, e.g. "60".
+ *
+ * @param buffer Output buffer of at least FORMAT_BUFFER_SIZE bytes.
+ * @param value The number to write.
+ * @return Length of the string written.
+ */
+size_t format_uint(char *buffer, uint32_t value);
+
+/**
+ * Writes a fixed-point number with all its decimals and a suffix, e.g.
+ * value 95 with 2 decimals and suffix "ap" becomes "0.95ap".
+ *
+ * @param buffer Output buffer of at least FORMAT_BUFFER_SIZE bytes.
+ * @param value The number, times 10^decimals.
+ * @param decimals Number of decimal places in value, at most 9.
+ * @param suffix Text to put after the number, at most 3 characters.
+ * @return Length of the string written.
+ */
+size_t format_fixed(char *buffer, uint32_t value, uint8_t decimals,
+    const char *suffix);
+
+/**
+ * Writes a count in compact form with a k/m/b suffix, e.g. 1850000 becomes
+ * "1.85m".
+ *
+ * @param buffer Output buffer of at least FORMAT_BUFFER_SIZE bytes.
+ * @param value The count.
+ * @return Length of the string written.
+ */
+size_t format_count(char *buffer, uint32_t value);
+
+/**
+ * Writes a duration in compact form, in ms or s, e.g. 12000000 becomes
+ * "12.0s".
+ *
+ * @param buffer Output buffer of at least FORMAT_BUFFER_SIZE bytes.
+ * @param us The duration in microseconds.
+ * @return Length of the string written.
+ */
+size_t format_duration_us(char *buffer, uint32_t us);
+
+/**
+ * Writes a percentage in compact form, e.g. 1234 becomes "12.3%".
+ *
+ * @param buffer Output buffer of at least FORMAT_BUFFER_SIZE bytes.
+ * @param value_x100 The percentage times 100.
+ * @return Length of the string written.
+ */
+size_t format_percent_x100(char *buffer, uint32_t value_x100);
+
+
+#endif  // __NUMBER_FORMAT_H__
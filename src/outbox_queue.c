@@ -0,0 +1,174 @@
+#include <pebble.h>
+#include "outbox_queue.h"
+#include "perf_stats.h"
+#include "logging.h"
+
+
+/** One queued message. */
+typedef struct {
+  uint32_t key;
+  int32_t value;
+  OutboxDataWriter writer;  // NULL for int32 messages
+} OutboxRequest;
+
+/** Pending requests, oldest first. */
+static OutboxRequest pending[OUTBOX_QUEUE_CAPACITY];
+static uint8_t pending_count;
+
+/** The message handed to the system, if any. */
+static OutboxRequest in_flight;
+static bool has_in_flight;
+
+/** Consecutive failures, for backoff. Reset by any successful send. */
+static uint8_t failures;
+
+/** Timer for the next retry, if one is scheduled. */
+static AppTimer *retry_timer;
+
+static void send_next(void);
+
+/**
+ * Finds a pending request by key.
+ *
+ * @return Its index in the pending queue, or -1 if none is pending.
+ */
+static int find_pending(uint32_t key) {
+  for (int i = 0; i < pending_count; i++) {
+    if (pending[i].key == key) return i;
+  }
+  return -1;
+}
+
+/**
+ * A Pebble AppTimerCallback that retries sending after a backoff delay.
+ *
+ * @param data Unused.
+ */
+static void retry_timer_handler(void *data) {
+  retry_timer = NULL;
+  perf_count(PERF_COUNTER_RETRIES);
+  send_next();
+}
+
+/**
+ * Schedules another send attempt after an exponentially growing delay, with
+ * up to 50% random jitter so retries don't line up with other traffic.
+ */
+static void schedule_retry(void) {
+  if (retry_timer) return;
+  uint32_t delay = OUTBOX_RETRY_MIN_MS;
+  for (uint8_t i = 1; i < failures && delay < OUTBOX_RETRY_MAX_MS; i++) {
+    delay *= 2;
+  }
+  if (delay > OUTBOX_RETRY_MAX_MS) delay = OUTBOX_RETRY_MAX_MS;
+  delay += rand() % (delay / 2 + 1);
+  LOG_DEBUG("Retrying App Message send in %d ms.", (int) delay);
+  retry_timer = app_timer_register(delay, retry_timer_handler, NULL);
+}
+
+/**
+ * Puts a failed message back at the head of the queue, unless a newer 
+ * request for the same key has been queued since.
+ */
+static void requeue_in_flight(void) {
+  has_in_flight = false;
+  if (find_pending(in_flight.key) >= 0) return;
+  if (pending_count == OUTBOX_QUEUE_CAPACITY) {
+    LOG_ERROR("Outbox queue full! Dropping key %d.", (int) in_flight.key);
+    return;
+  }
+  memmove(&pending[1], &pending[0], pending_count * sizeof(pending[0]));
+  pending[0] = in_flight;
+  pending_count++;
+}
+
+/**
+ * Hands the oldest pending request to the system, unless something is 
+ * already in flight or waiting out a backoff.
+ */
+static void send_next(void) {
+  if (has_in_flight || retry_timer || pending_count == 0) return;
+
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if (result != APP_MSG_OK || iter == NULL) {
+    LOG_WARNING("Outbox unavailable. Error: %d", result);
+    failures++;
+    schedule_retry();
+    return;
+  }
+  in_flight = pending[0];
+  pending_count--;
+  memmove(&pending[0], &pending[1], pending_count * sizeof(pending[0]));
+  has_in_flight = true;
+
+  if (in_flight.writer) {
+    in_flight.writer(iter, in_flight.key);
+  } else {
+    Tuplet tuplet = TupletInteger(in_flight.key, in_flight.value);
+    dict_write_tuplet(iter, &tuplet);
+  }
+  dict_write_end(iter);
+  result = app_message_outbox_send();
+  if (result != APP_MSG_OK) {
+    LOG_WARNING("Failed to send App Message. Error: %d", result);
+    perf_count(PERF_COUNTER_SEND_FAILED);
+    requeue_in_flight();
+    failures++;
+    schedule_retry();
+  }
+}
+
+/**
+ * Queues a request, merging it into a pending one with the same key.
+ *
+ * @param request The request to queue.
+ */
+static void enqueue(OutboxRequest request) {
+  int index = find_pending(request.key);
+  if (index >= 0) {
+    pending[index] = request;
+  } else if (pending_count < OUTBOX_QUEUE_CAPACITY) {
+    pending[pending_count++] = request;
+  } else {
+    LOG_ERROR("Outbox queue full! Dropping key %d.", (int) request.key);
+    return;
+  }
+  send_next();
+}
+
+// Docs are in the header file.
+void outbox_queue_send_int(uint32_t key, int32_t value) {
+  enqueue((OutboxRequest) { .key = key, .value = value });
+}
+
+// Docs are in the header file.
+void outbox_queue_send_data(uint32_t key, OutboxDataWriter writer) {
+  enqueue((OutboxRequest) { .key = key, .writer = writer });
+}
+
+// Docs are in the header file.
+void outbox_queue_handle_sent(DictionaryIterator *sent, void *context) {
+  has_in_flight = false;
+  failures = 0;
+  send_next();
+}
+
+// Docs are in the header file.
+void outbox_queue_handle_failed(DictionaryIterator *failed, 
+    AppMessageResult reason, void *context) {
+  LOG_ERROR("App Message failed to send! Reason: %d", reason);
+  perf_count(PERF_COUNTER_SEND_FAILED);
+  if (!has_in_flight) return;
+  requeue_in_flight();
+  failures++;
+  schedule_retry();
+}
+
+// Docs are in the header file.
+void outbox_queue_deinit(void) {
+  if (retry_timer) app_timer_cancel(retry_timer);
+  retry_timer = NULL;
+  pending_count = 0;
+  has_in_flight = false;
+}
@@ -0,0 +1,86 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module queues App Messages to the phone. Pebble only has one outbox,
+ * so sends from different places (timers, Bluetooth reconnects, startup) 
+ * otherwise collide and fail with APP_MSG_BUSY. Requests wait in a small 
+ * fixed-size queue, with one message in flight at a time. A request for a key
+ * that's already pending is merged into the pending one. Failed sends are 
+ * retried with exponential backoff plus jitter, so nothing is silently lost
+ * and a reconnect doesn't flood the link.
+ */
+
+#ifndef __OUTBOX_QUEUE_H__
+#define __OUTBOX_QUEUE_H__
+
+#include <pebble.h>
+
+
+/** Max number of distinct pending requests. */
+#define OUTBOX_QUEUE_CAPACITY 4
+
+/** Delay before the first retry of a failed send. */
+#define OUTBOX_RETRY_MIN_MS 1000
+
+/** Retry delays double after each failure, up to this limit. */
+#define OUTBOX_RETRY_MAX_MS 60000
+
+/**
+ * Queues a single-tuple int32 message for the phone. If a message with the 
+ * same key is already waiting, it's updated to the new value instead.
+ *
+ * @param key The AppMessageKey to send.
+ * @param value The value to send.
+ */
+void outbox_queue_send_int(uint32_t key, int32_t value);
+
+/**
+ * Writes the payload of a queued message when its turn comes to be sent.
+ *
+ * @param iter The message being built. Only the value for key should be
+ *        written to it.
+ * @param key The AppMessageKey the message was queued under.
+ */
+typedef void (*OutboxDataWriter)(DictionaryIterator *iter, uint32_t key);
+
+/**
+ * Queues a single-tuple message whose value is produced at send time, for 
+ * payloads that are big or should be as fresh as possible when they go out.
+ * If a message with the same key is already waiting, the two are merged.
+ *
+ * @param key The AppMessageKey to send.
+ * @param writer Writes the tuple for key into the outbound message. Called 
+ *        again for each retry.
+ */
+void outbox_queue_send_data(uint32_t key, OutboxDataWriter writer);
+
+/**
+ * A Pebble AppMessageOutboxSent handler. Parent must register/dispatch to 
+ * this handler since each app can only have one.
+ *
+ * @param sent The message that was sent.
+ * @param context Application data as specified when registering the callback.
+ *        Unused.
+ */
+void outbox_queue_handle_sent(DictionaryIterator *sent, void *context);
+
+/**
+ * A Pebble AppMessageOutboxFailed handler. Parent must register/dispatch to 
+ * this handler since each app can only have one.
+ *
+ * @param failed The message that failed to send.
+ * @param reason Why the message failed to send (error code).
+ * @param context Application data as specified when registering the callback.
+ *        Unused.
+ */
+void outbox_queue_handle_failed(DictionaryIterator *failed, 
+    AppMessageResult reason, void *context);
+
+/**
+ * Must be called to cancel pending retries before the app exits. Anything 
+ * still queued is dropped.
+ */
+void outbox_queue_deinit(void);
+
+
+#endif  // __OUTBOX_QUEUE_H__
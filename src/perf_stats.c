@@ -0,0 +1,129 @@
+#include <pebble.h>
+#include "perf_stats.h"
+#include "outbox_queue.h"
+#include "appkeys.auto.h"
+
+
+/** Latency stats of one timed code path. */
+typedef struct {
+  uint32_t calls;
+  uint32_t total_ms;
+  uint16_t max_ms;
+  uint16_t buckets[PERF_HISTOGRAM_BUCKETS];
+} PerfTimerStats;
+
+/** All the stats, in one fixed block. */
+static struct {
+  time_t started;
+  PerfTimerStats timers[PERF_TIMER_COUNT];
+  uint32_t counters[PERF_COUNTER_COUNT];
+} stats;
+
+/**
+ * Writes a little-endian uint16 to an arbitrarily aligned buffer.
+ */
+static void write_uint16(uint8_t *data, uint16_t value) {
+  data[0] = value & 0xFF;
+  data[1] = value >> 8;
+}
+
+/**
+ * Writes a little-endian uint32 to an arbitrarily aligned buffer.
+ */
+static void write_uint32(uint8_t *data, uint32_t value) {
+  data[0] = value & 0xFF;
+  data[1] = (value >> 8) & 0xFF;
+  data[2] = (value >> 16) & 0xFF;
+  data[3] = value >> 24;
+}
+
+/**
+ * Picks the histogram bucket for a call duration.
+ *
+ * @param elapsed_ms How long the call took.
+ * @return The bucket index: 0 for under 1 ms, else 1 + floor(log2(ms)),
+ *         capped at the last bucket.
+ */
+static uint8_t bucket_for(uint32_t elapsed_ms) {
+  uint8_t bucket = 0;
+  while (elapsed_ms > 0 && bucket < PERF_HISTOGRAM_BUCKETS - 1) {
+    elapsed_ms >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+// Docs are in the header file.
+void perf_stats_init(void) {
+  memset(&stats, 0, sizeof(stats));
+  stats.started = time(NULL);
+}
+
+// Docs are in the header file.
+uint32_t perf_timer_start(void) {
+  time_t secs;
+  uint16_t ms = time_ms(&secs, NULL);
+  return (uint32_t) secs * 1000 + ms;
+}
+
+// Docs are in the header file.
+void perf_timer_stop(PerfTimer timer, uint32_t started) {
+  uint32_t elapsed = perf_timer_start() - started;
+  // The clock can be set backwards mid-call; don't record that as ~49 days:
+  if (elapsed > INT32_MAX) elapsed = 0;
+
+  PerfTimerStats *timer_stats = &stats.timers[timer];
+  if (timer_stats->calls < UINT32_MAX) timer_stats->calls++;
+  if (timer_stats->total_ms <= UINT32_MAX - elapsed) {
+    timer_stats->total_ms += elapsed;
+  }
+  if (elapsed > timer_stats->max_ms) {
+    timer_stats->max_ms = elapsed < UINT16_MAX ? elapsed : UINT16_MAX;
+  }
+  uint16_t *bucket = &timer_stats->buckets[bucket_for(elapsed)];
+  if (*bucket < UINT16_MAX) (*bucket)++;
+}
+
+// Docs are in the header file.
+void perf_count(PerfCounter counter) {
+  if (stats.counters[counter] < UINT32_MAX) stats.counters[counter]++;
+}
+
+// Docs are in the header file.
+size_t perf_stats_encode(uint8_t *data) {
+  data[0] = PERF_STATS_VERSION;
+  data[1] = PERF_TIMER_COUNT;
+  data[2] = PERF_HISTOGRAM_BUCKETS;
+  data[3] = PERF_COUNTER_COUNT;
+  write_uint32(data + 4, time(NULL) - stats.started);
+  uint8_t *out = data + 8;
+  for (int i = 0; i < PERF_TIMER_COUNT; i++) {
+    const PerfTimerStats *timer_stats = &stats.timers[i];
+    write_uint32(out, timer_stats->calls);
+    write_uint32(out + 4, timer_stats->total_ms);
+    write_uint16(out + 8, timer_stats->max_ms);
+    out += 10;
+    for (int b = 0; b < PERF_HISTOGRAM_BUCKETS; b++) {
+      write_uint16(out, timer_stats->buckets[b]);
+      out += 2;
+    }
+  }
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    write_uint32(out, stats.counters[i]);
+    out += 4;
+  }
+  return out - data;
+}
+
+// Docs are in the header file.
+void perf_stats_write(DictionaryIterator *iter, uint32_t key) {
+  uint8_t snapshot[PERF_STATS_SIZE];
+  size_t size = perf_stats_encode(snapshot);
+  dict_write_data(iter, key, snapshot, size);
+}
+
+// Docs are in appkeys.auto.h (AppKeyHandler).
+void perf_stats_handle_request(const Tuple *tuple) {
+  if (tuple->value->int32 == 0) return;
+  outbox_queue_send_data(PERF_STATS_KEY, perf_stats_write);
+}
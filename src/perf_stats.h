@@ -0,0 +1,116 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module is compiled-in instrumentation for the watch's hot paths: how
+ * long the App Message handler, display updates, the minute tick and the
+ * layer update procs take, and how often messages are received, dropped,
+ * fail to send or get retried. Everything lives in one fixed static block, so
+ * recording costs a couple of integer ops and never allocates or touches
+ * storage. Stats cover the current run of the app.
+ *
+ * The phone asks for a snapshot with PERF_REQ_KEY, and we answer with
+ * PERF_STATS_KEY, packed as follows (integers are little-endian):
+ *
+ *   Offset  Size  Field
+ *   0       1     Format version (PERF_STATS_VERSION)
+ *   1       1     Number of timers (PERF_TIMER_COUNT)
+ *   2       1     Histogram buckets per timer (PERF_HISTOGRAM_BUCKETS)
+ *   3       1     Number of counters (PERF_COUNTER_COUNT)
+ *   4       4     Seconds since the stats started
+ *   8       ...   Per timer, in PerfTimer order:
+ *                   4  Number of calls
+ *                   4  Total time in ms
+ *                   2  Longest call in ms
+ *                   2  Per bucket, number of calls (see below)
+ *   ...     4     Per counter, in PerfCounter order: its value
+ *
+ * Bucket 0 counts calls under 1 ms, bucket i (i > 0) calls of 2^(i-1) up to
+ * 2^i - 1 ms, and the last bucket everything longer. The watch clock only has
+ * millisecond resolution, so most calls land in bucket 0; totals and calls
+ * still give a fair average over many calls. Counts saturate rather than
+ * wrap.
+ */
+
+#ifndef __PERF_STATS_H__
+#define __PERF_STATS_H__
+
+#include <pebble.h>
+
+
+/** Version of the snapshot format. Bump on incompatible changes. */
+#define PERF_STATS_VERSION 1
+
+/** Number of log2 latency buckets per timer. The last one is open-ended. */
+#define PERF_HISTOGRAM_BUCKETS 8
+
+/** Timed code paths. Append only; the phone decodes them by position. */
+typedef enum {
+  PERF_TIMER_MESSAGE,         // newrelic_app_msg_in_received_handler
+  PERF_TIMER_DISPLAY,         // display_newrelic_data
+  PERF_TIMER_MINUTE_TICK,     // clock_layer_handle_minute_tick
+  PERF_TIMER_DRAW_METRICS,    // the metrics layer's update proc
+  PERF_TIMER_DRAW_SPARKLINE,  // the sparkline layer's update proc
+  PERF_TIMER_DRAW_SERIES,     // the series layer's update proc
+  PERF_TIMER_COUNT,
+} PerfTimer;
+
+/** Counted events. Append only; the phone decodes them by position. */
+typedef enum {
+  PERF_COUNTER_RECEIVED,     // App Messages received
+  PERF_COUNTER_DROPPED,      // inbound App Messages dropped
+  PERF_COUNTER_SEND_FAILED,  // outbound App Messages that failed
+  PERF_COUNTER_RETRIES,      // outbound retries after a failure
+  PERF_COUNTER_COUNT,
+} PerfCounter;
+
+/** Size of a packed snapshot, in bytes. */
+#define PERF_STATS_SIZE (8 + PERF_TIMER_COUNT * \
+    (10 + 2 * PERF_HISTOGRAM_BUCKETS) + PERF_COUNTER_COUNT * 4)
+
+/**
+ * Should be called once at startup, before anything is recorded. Starts the
+ * clock that snapshots report their age against.
+ */
+void perf_stats_init(void);
+
+/**
+ * Starts timing a call. Pass the result to perf_timer_stop when it's done.
+ *
+ * @return The current time, in ms from an arbitrary starting point.
+ */
+uint32_t perf_timer_start(void);
+
+/**
+ * Records one timed call.
+ *
+ * @param timer Which code path was timed.
+ * @param started What perf_timer_start returned at the start of the call.
+ */
+void perf_timer_stop(PerfTimer timer, uint32_t started);
+
+/**
+ * Counts one event.
+ *
+ * @param counter The event that happened.
+ */
+void perf_count(PerfCounter counter);
+
+/**
+ * Packs the current stats into a snapshot, as described above.
+ *
+ * @param data Output buffer of at least PERF_STATS_SIZE bytes.
+ * @return Size of the snapshot in bytes.
+ */
+size_t perf_stats_encode(uint8_t *data);
+
+/**
+ * Writes a snapshot into an outbound message. An OutboxDataWriter (see
+ * outbox_queue.h), so the snapshot is taken when it's actually sent.
+ *
+ * @param iter The message being built.
+ * @param key The AppMessageKey to write the snapshot under.
+ */
+void perf_stats_write(DictionaryIterator *iter, uint32_t key);
+
+
+#endif  // __PERF_STATS_H__
@@ -0,0 +1,27 @@
+/**
+ * @section DESCRIPTION
+ *
+ * Keys for everything we store with the Pebble persist API. They're all kept 
+ * here so that modules can't accidentally collide. Never reuse a retired key
+ * for different data, since old values survive app upgrades.
+ */
+
+#ifndef __PERSIST_KEYS_H__
+#define __PERSIST_KEYS_H__
+
+
+enum PersistKey {
+  // Key:                   // Value:
+  SNAPSHOT_PERSIST_KEY = 1, // data - last-known New Relic display state
+  HISTORY_HEADER_PERSIST_KEY = 2,     // data - metric history ring state
+  SNAPSHOT_OVERFLOW_PERSIST_KEY = 3,  // data - rest of the display state, if
+                                      //        it doesn't fit the first key
+  TRACE_HEADER_PERSIST_KEY = 4,       // data - inbox trace recorder state
+  HISTORY_PAGE_PERSIST_KEY_BASE = 16, // data - metric history delta pages,
+                                      //        one key per page from here
+  TRACE_PAGE_PERSIST_KEY_BASE = 32,   // data - inbox trace record pages,
+                                      //        one key per page from here
+};
+
+
+#endif  // __PERSIST_KEYS_H__
@@ -0,0 +1,82 @@
+#include <pebble.h>
+#include "resource_cache.h"
+#include "logging.h"
+
+
+/** One loaded resource. Unused entries have ref_count 0. */
+typedef struct {
+  uint32_t resource_id;
+  GFont font;
+  uint16_t ref_count;
+  uint16_t heap_bytes;  // heap consumed by the load
+} ResourceCacheEntry;
+
+static ResourceCacheEntry entries[RESOURCE_CACHE_CAPACITY];
+
+/**
+ * Finds the loaded entry for a resource.
+ *
+ * @param resource_id The RESOURCE_ID_* to look for.
+ * @return The entry, or NULL if the resource isn't loaded.
+ */
+static ResourceCacheEntry *find_entry(uint32_t resource_id) {
+  for (int i = 0; i < RESOURCE_CACHE_CAPACITY; i++) {
+    if (entries[i].ref_count > 0 && entries[i].resource_id == resource_id) {
+      return &entries[i];
+    }
+  }
+  return NULL;
+}
+
+// Docs are in the header file.
+GFont resource_cache_get_font(uint32_t resource_id) {
+  ResourceCacheEntry *entry = find_entry(resource_id);
+  if (entry) {
+    entry->ref_count++;
+    return entry->font;
+  }
+
+  // Not loaded yet, so find a free slot:
+  for (int i = 0; i < RESOURCE_CACHE_CAPACITY; i++) {
+    if (entries[i].ref_count == 0) {
+      entry = &entries[i];
+      break;
+    }
+  }
+  if (!entry) {
+    LOG_ERROR("Resource cache full! Can't load %d.", (int) resource_id);
+    return NULL;
+  }
+
+  size_t heap_before = heap_bytes_used();
+  entry->font = fonts_load_custom_font(resource_get_handle(resource_id));
+  entry->heap_bytes = heap_bytes_used() - heap_before;
+  entry->resource_id = resource_id;
+  entry->ref_count = 1;
+  LOG_DEBUG("Loaded font %d using %d heap bytes.", 
+      (int) resource_id, entry->heap_bytes);
+  return entry->font;
+}
+
+// Docs are in the header file.
+void resource_cache_release_font(uint32_t resource_id) {
+  ResourceCacheEntry *entry = find_entry(resource_id);
+  if (!entry) {
+    LOG_ERROR("Released font %d that isn't loaded!", (int) resource_id);
+    return;
+  }
+  if (--entry->ref_count == 0) {
+    fonts_unload_custom_font(entry->font);
+    entry->font = NULL;
+    entry->heap_bytes = 0;
+  }
+}
+
+// Docs are in the header file.
+size_t resource_cache_heap_bytes(void) {
+  size_t total = 0;
+  for (int i = 0; i < RESOURCE_CACHE_CAPACITY; i++) {
+    if (entries[i].ref_count > 0) total += entries[i].heap_bytes;
+  }
+  return total;
+}
@@ -0,0 +1,45 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module shares custom fonts between display modules. Every call to 
+ * fonts_load_custom_font loads another copy of the font into the app heap, so
+ * modules get their fonts from here instead: each resource is loaded once, 
+ * handed out to every caller, and unloaded when the last user releases it.
+ */
+
+#ifndef __RESOURCE_CACHE_H__
+#define __RESOURCE_CACHE_H__
+
+#include <pebble.h>
+
+
+/** Max number of distinct resources that can be loaded at the same time. */
+#define RESOURCE_CACHE_CAPACITY 4
+
+/**
+ * Returns a shared handle to the given custom font, loading it if this is the
+ * first user. Each call must be balanced by resource_cache_release_font.
+ *
+ * @param resource_id The RESOURCE_ID_* of the font.
+ * @return The loaded font, or NULL if the cache is full.
+ */
+GFont resource_cache_get_font(uint32_t resource_id);
+
+/**
+ * Drops one reference to a font from resource_cache_get_font. The font is 
+ * unloaded once nobody uses it anymore.
+ *
+ * @param resource_id The RESOURCE_ID_* of the font.
+ */
+void resource_cache_release_font(uint32_t resource_id);
+
+/**
+ * Reports how much app heap the currently loaded resources take up, as 
+ * measured when each one was loaded.
+ *
+ * @return Heap usage in bytes.
+ */
+size_t resource_cache_heap_bytes(void);
+
+
+#endif  // __RESOURCE_CACHE_H__
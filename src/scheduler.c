@@ -0,0 +1,54 @@
+#include <pebble.h>
+#include "scheduler.h"
+#include "logging.h"
+
+
+/** One scheduled job. Unused entries have a NULL job. */
+typedef struct {
+  SchedulerJob job;
+  uint16_t period_mins;
+} ScheduledJob;
+
+static ScheduledJob jobs[SCHEDULER_CAPACITY];
+
+/**
+ * Finds a scheduled job.
+ *
+ * @return Its entry, or NULL if it isn't scheduled.
+ */
+static ScheduledJob *find_job(SchedulerJob job) {
+  for (int i = 0; i < SCHEDULER_CAPACITY; i++) {
+    if (jobs[i].job == job) return &jobs[i];
+  }
+  return NULL;
+}
+
+// Docs are in the header file.
+void scheduler_schedule(SchedulerJob job, uint16_t period_mins) {
+  if (period_mins < 1) period_mins = 1;
+  ScheduledJob *entry = find_job(job);
+  if (!entry) entry = find_job(NULL);
+  if (!entry) {
+    LOG_ERROR("Scheduler full! Can't schedule job.");
+    return;
+  }
+  entry->job = job;
+  entry->period_mins = period_mins;
+}
+
+// Docs are in the header file.
+void scheduler_cancel(SchedulerJob job) {
+  ScheduledJob *entry = find_job(job);
+  if (entry) entry->job = NULL;
+}
+
+// Docs are in the header file.
+void scheduler_handle_minute_tick(struct tm *tick_time) {
+  // Epoch minutes, rather than tick_time's fields, so that periods that don't
+  // divide a day still run evenly across midnight:
+  uint32_t minute = time(NULL) / 60;
+  for (int i = 0; i < SCHEDULER_CAPACITY; i++) {
+    // Jobs may (un)schedule jobs, so re-check each entry as we go.
+    if (jobs[i].job && minute % jobs[i].period_mins == 0) jobs[i].job();
+  }
+}
@@ -0,0 +1,52 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module runs periodic jobs off the minute tick that the clock already 
+ * needs, instead of each job keeping its own AppTimer. Jobs with a period of
+ * N minutes run on every minute boundary divisible by N, so jobs that fall 
+ * due together share one wakeup and never drift against the clock. A job's 
+ * schedule depends only on the wall clock, so re-registering it (e.g. on a 
+ * config change) doesn't reset or delay it.
+ */
+
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <pebble.h>
+
+
+/** Max number of jobs that can be scheduled at once. */
+#define SCHEDULER_CAPACITY 4
+
+/**
+ * A periodic job.
+ */
+typedef void (*SchedulerJob)(void);
+
+/**
+ * Runs a job every period_mins minutes, aligned to the minute boundaries
+ * divisible by period_mins. If the job is already scheduled, only its 
+ * period changes.
+ *
+ * @param job The job to run.
+ * @param period_mins How often to run it, in minutes. Must be at least 1.
+ */
+void scheduler_schedule(SchedulerJob job, uint16_t period_mins);
+
+/**
+ * Stops running a job. Does nothing if it isn't scheduled.
+ *
+ * @param job The job to stop.
+ */
+void scheduler_cancel(SchedulerJob job);
+
+/**
+ * Runs all jobs that are due at the given minute. Parent must dispatch to 
+ * this from its MINUTE_UNIT TickHandler, since each app can only have one.
+ *
+ * @param tick_time The time at which the tick event was triggered.
+ */
+void scheduler_handle_minute_tick(struct tm *tick_time);
+
+
+#endif  // __SCHEDULER_H__
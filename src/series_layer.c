@@ -0,0 +1,119 @@
+#include <pebble.h>
+#include "series_layer.h"
+#include "newrelic_protocol.h"
+#include "resource_cache.h"
+#include "number_format.h"
+#include "perf_stats.h"
+#include "logging.h"
+
+
+/** Height of the label row above the chart. */
+#define LABEL_HEIGHT 13
+
+static Layer *series_layer;
+
+/** The series being charted. Empty (count 0) until the phone sends one. */
+static NewrelicSeries series;
+
+/** Font for the label row. */
+static GFont font_12;
+
+/**
+ * Formats the label shown above the chart: the time window and the range of
+ * values it spans, e.g. "60m: 120ms-1.20s".
+ *
+ * @param buffer Output buffer. Should be at least 32 bytes.
+ */
+static void format_label(char *buffer) {
+  char *out = buffer;
+  out += format_uint(out, series.window_mins);
+  out += format_text(out, "m: ");
+  if (series.metric == NEWRELIC_SERIES_RESPONSE_TIME) {
+    out += format_duration_us(out, series.min);
+    out += format_text(out, "-");
+    format_duration_us(out, series.max);
+  } else {
+    out += format_count(out, series.min);
+    out += format_text(out, "-");
+    out += format_count(out, series.max);
+    format_text(out, "rpm");
+  }
+}
+
+/**
+ * Draws the label row and the chart. Each point is a filled column rising 
+ * from the bottom; if there are fewer points than pixel columns, the columns
+ * are widened to fill the chart.
+ *
+ * @param layer The layer that needs to be rendered.
+ * @param ctx The destination graphics context to draw into.
+ */
+static void draw_series(Layer *layer, GContext *ctx) {
+  if (series.count == 0) return;
+  GRect bounds = layer_get_bounds(layer);
+  char label[32];
+  format_label(label);
+  graphics_context_set_text_color(ctx, GColorWhite);
+  graphics_draw_text(ctx, label, font_12, 
+      GRect(0, -2, bounds.size.w, LABEL_HEIGHT + 2), 
+      GTextOverflowModeTrailingEllipsis, GTextAlignmentCenter, NULL);
+
+  int16_t height = bounds.size.h - LABEL_HEIGHT;
+  graphics_context_set_fill_color(ctx, GColorWhite);
+  for (uint8_t i = 0; i < series.count; i++) {
+    int16_t x = i * bounds.size.w / series.count;
+    int16_t next_x = (i + 1) * bounds.size.w / series.count;
+    int16_t bar = 1 + series.points[i] * (height - 1) / 255;
+    graphics_fill_rect(ctx, GRect(x, bounds.size.h - bar, next_x - x, bar), 
+        0, GCornerNone);
+  }
+}
+
+/**
+ * A Pebble LayerUpdateProc for the series chart. Times the drawing.
+ *
+ * @param layer The layer that needs to be rendered.
+ * @param ctx The destination graphics context to draw into.
+ */
+static void series_layer_update_callback(Layer *layer, GContext *ctx) {
+  uint32_t started = perf_timer_start();
+  draw_series(layer, ctx);
+  perf_timer_stop(PERF_TIMER_DRAW_SERIES, started);
+}
+
+// Docs are in the header file.
+bool series_layer_set_data(const uint8_t *data, size_t length) {
+  if (!newrelic_series_decode(data, length, &series)) return false;
+  layer_mark_dirty(series_layer);
+  LOG_INFO("Updated series chart: %d points over %d mins.",
+      series.count, series.window_mins);
+  return true;
+}
+
+// Docs are in the header file.
+bool series_layer_has_data(void) {
+  return series.count > 0;
+}
+
+// Docs are in the header file.
+void series_layer_set_hidden(bool hidden) {
+  if (layer_get_hidden(series_layer) != hidden) {
+    layer_set_hidden(series_layer, hidden);
+  }
+}
+
+// Docs are in the header file.
+void series_layer_init(Layer *parent_layer, GRect frame) {
+  font_12 = resource_cache_get_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_12);
+  series.count = 0;
+  series_layer = layer_create(frame);
+  layer_set_update_proc(series_layer, series_layer_update_callback);
+  layer_set_hidden(series_layer, true);
+  layer_add_child(parent_layer, series_layer);
+}
+
+// Docs are in the header file.
+void series_layer_deinit(void) {
+  layer_destroy(series_layer);
+  resource_cache_release_font(RESOURCE_ID_FONT_SIGNIKA_REGULAR_12);
+}
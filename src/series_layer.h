@@ -0,0 +1,53 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module charts a time series of one metric, as fetched by the phone 
+ * (see NewrelicSeries). The phone has already reduced the series to at most
+ * one point per pixel column, so drawing it costs the same no matter how 
+ * long a time window it covers.
+ */
+
+#ifndef __SERIES_LAYER_H__
+#define __SERIES_LAYER_H__
+
+#include <pebble.h>
+
+
+/**
+ * Must be called to initialize the series chart before any other use of 
+ * this module. The chart starts out hidden and empty. The companion 
+ * destructor is series_layer_deinit.
+ *
+ * @param parent_layer The Layer to insert the chart into.
+ * @param frame Where to draw the chart within the parent.
+ */
+void series_layer_init(Layer *parent_layer, GRect frame);
+
+/**
+ * Replaces the charted series.
+ *
+ * @param data A packed series as received from the phone.
+ * @param length Number of bytes available at data.
+ * @return True if the payload was valid. Invalid payloads keep the old chart.
+ */
+bool series_layer_set_data(const uint8_t *data, size_t length);
+
+/**
+ * @return True if there's a series to chart.
+ */
+bool series_layer_has_data(void);
+
+/**
+ * Shows or hides the chart.
+ *
+ * @param hidden True to hide the chart.
+ */
+void series_layer_set_hidden(bool hidden);
+
+/**
+ * Must be called to destroy the data allocated by series_layer_init.
+ */
+void series_layer_deinit(void);
+
+
+#endif  // __SERIES_LAYER_H__
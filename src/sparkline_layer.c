@@ -0,0 +1,176 @@
+#include <pebble.h>
+#include "sparkline_layer.h"
+#include "perf_stats.h"
+
+
+static Layer *sparkline_layer;
+
+/** Offscreen copy of the chart. 1 bits are white. */
+static GBitmap *canvas;
+
+/** The metric being charted. */
+static HistoryMetric charted_metric;
+
+/** Value range that the chart's vertical axis currently spans. */
+static uint32_t range_min, range_max;
+
+/** Number of columns on the canvas that hold a sample. */
+static uint16_t columns_drawn;
+
+/** Bookkeeping for a full redraw, passed through metric_history_for_each. */
+typedef struct {
+  uint16_t first_index;   // history index drawn in the first used column
+  uint16_t first_column;  // canvas column of that sample
+} RenderContext;
+
+/**
+ * Draws one sample as a filled column rising from the bottom of the canvas.
+ * The column must already be clear.
+ *
+ * @param x The canvas column.
+ * @param value The sample value.
+ */
+static void draw_column(int16_t x, uint32_t value) {
+  int16_t height = canvas->bounds.size.h;
+  int16_t bar = 1;
+  if (range_max > range_min) {
+    bar += (int16_t) ((uint64_t) (value - range_min) * (height - 1) / 
+        (range_max - range_min));
+  }
+  uint8_t *data = canvas->addr;
+  for (int16_t y = height - bar; y < height; y++) {
+    data[y * canvas->row_size_bytes + x / 8] |= 1 << (x % 8);
+  }
+}
+
+/**
+ * Shifts the whole canvas one column to the left, clearing the last column.
+ * Pebble bitmaps store the leftmost pixel of each byte in its lowest bit.
+ */
+static void shift_canvas_left(void) {
+  uint8_t *data = canvas->addr;
+  int16_t width = canvas->bounds.size.w;
+  uint16_t row_bytes = canvas->row_size_bytes;
+  for (int16_t y = 0; y < canvas->bounds.size.h; y++) {
+    uint8_t *row = data + y * row_bytes;
+    for (uint16_t i = 0; i < row_bytes - 1; i++) {
+      row[i] = (row[i] >> 1) | (row[i + 1] << 7);
+    }
+    row[row_bytes - 1] >>= 1;
+    row[(width - 1) / 8] &= ~(1 << ((width - 1) % 8));
+  }
+}
+
+/**
+ * A HistorySampleCallback that widens the chart range to include a sample.
+ */
+static void include_in_range(uint16_t index, uint32_t value, void *context) {
+  if (value < range_min) range_min = value;
+  if (value > range_max) range_max = value;
+}
+
+/**
+ * A HistorySampleCallback that draws one sample during a full redraw.
+ */
+static void render_sample(uint16_t index, uint32_t value, void *context) {
+  RenderContext *render = context;
+  draw_column(render->first_column + index - render->first_index, value);
+}
+
+/**
+ * Redraws the whole chart from history, rescaling it to fit the visible 
+ * samples.
+ */
+static void render_all(void) {
+  int16_t width = canvas->bounds.size.w;
+  memset(canvas->addr, 0, canvas->row_size_bytes * canvas->bounds.size.h);
+  uint16_t count = metric_history_count();
+  columns_drawn = count < width ? count : width;
+  if (columns_drawn == 0) return;
+
+  RenderContext render = {
+    .first_index = count - columns_drawn,
+    .first_column = width - columns_drawn,
+  };
+  range_min = UINT32_MAX;
+  range_max = 0;
+  metric_history_for_each(charted_metric, render.first_index, 
+      include_in_range, NULL);
+  metric_history_for_each(charted_metric, render.first_index, 
+      render_sample, &render);
+}
+
+/**
+ * A Pebble LayerUpdateProc that copies the chart to the screen.
+ *
+ * @param layer The layer that needs to be rendered.
+ * @param ctx The destination graphics context to draw into.
+ */
+static void sparkline_layer_update_callback(Layer *layer, GContext *ctx) {
+  uint32_t started = perf_timer_start();
+  graphics_draw_bitmap_in_rect(ctx, canvas, layer_get_bounds(layer));
+  perf_timer_stop(PERF_TIMER_DRAW_SPARKLINE, started);
+}
+
+/**
+ * A HistorySampleCallback that clears the flag it's passed if a sample falls
+ * outside the chart's current range.
+ */
+static void check_in_range(uint16_t index, uint32_t value, void *context) {
+  bool *in_range = context;
+  if (value < range_min || value > range_max) *in_range = false;
+}
+
+/**
+ * A HistorySampleCallback that scrolls the chart one column and draws a new
+ * sample in the last one.
+ */
+static void append_sample(uint16_t index, uint32_t value, void *context) {
+  shift_canvas_left();
+  draw_column(canvas->bounds.size.w - 1, value);
+  if (columns_drawn < canvas->bounds.size.w) columns_drawn++;
+}
+
+// Docs are in the header file.
+void sparkline_layer_add_latest(uint16_t added) {
+  uint16_t count = metric_history_count();
+  if (count == 0 || added == 0) return;
+  if (added > count) added = count;
+  bool in_range = columns_drawn > 0 && added < canvas->bounds.size.w;
+  if (in_range) {
+    metric_history_for_each(charted_metric, count - added, check_in_range, 
+        &in_range);
+  }
+  if (in_range) {
+    metric_history_for_each(charted_metric, count - added, append_sample, 
+        NULL);
+  } else {
+    render_all();
+  }
+  layer_mark_dirty(sparkline_layer);
+}
+
+// Docs are in the header file.
+void sparkline_layer_set_hidden(bool hidden) {
+  if (layer_get_hidden(sparkline_layer) != hidden) {
+    layer_set_hidden(sparkline_layer, hidden);
+  }
+}
+
+// Docs are in the header file.
+void sparkline_layer_init(Layer *parent_layer, GRect frame, 
+    HistoryMetric metric) {
+  charted_metric = metric;
+  canvas = gbitmap_create_blank(frame.size);
+  render_all();
+
+  sparkline_layer = layer_create(frame);
+  layer_set_update_proc(sparkline_layer, sparkline_layer_update_callback);
+  layer_add_child(parent_layer, sparkline_layer);
+}
+
+// Docs are in the header file.
+void sparkline_layer_deinit(void) {
+  layer_destroy(sparkline_layer);
+  gbitmap_destroy(canvas);
+}
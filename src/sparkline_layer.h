@@ -0,0 +1,52 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module draws a small sparkline of one metric's recent history, one 
+ * minute per pixel column (see metric_history.h). The chart is kept in an 
+ * offscreen bitmap: each new sample shifts the bitmap one column left and 
+ * draws only the new column, and the whole chart is only redrawn when a 
+ * sample falls outside the current vertical range.
+ */
+
+#ifndef __SPARKLINE_LAYER_H__
+#define __SPARKLINE_LAYER_H__
+
+#include <pebble.h>
+#include "metric_history.h"
+
+
+/**
+ * Must be called to initialize the sparkline before any other use of this 
+ * module. Draws whatever history is already available. The companion 
+ * destructor is sparkline_layer_deinit.
+ *
+ * @param parent_layer The Layer to insert the sparkline into.
+ * @param frame Where to draw the sparkline within the parent. One sample, 
+ *        i.e. one minute, is shown per pixel column.
+ * @param metric The metric to chart.
+ */
+void sparkline_layer_init(Layer *parent_layer, GRect frame, 
+    HistoryMetric metric);
+
+/**
+ * Adds the newest history samples to the chart. Call after each 
+ * metric_history_push that added any.
+ *
+ * @param added Number of samples the push added.
+ */
+void sparkline_layer_add_latest(uint16_t added);
+
+/**
+ * Shows or hides the sparkline.
+ *
+ * @param hidden True to hide the sparkline.
+ */
+void sparkline_layer_set_hidden(bool hidden);
+
+/**
+ * Must be called to destroy the data allocated by sparkline_layer_init.
+ */
+void sparkline_layer_deinit(void);
+
+
+#endif  // __SPARKLINE_LAYER_H__
@@ -0,0 +1,111 @@
+#include <pebble.h>
+#include "transfer.h"
+#include "appkeys.auto.h"
+#include "outbox_queue.h"
+#include "logging.h"
+
+
+/** Byte offsets of the chunk header fields. */
+enum ChunkOffset {
+  CHUNK_ID_OFFSET = 0,
+  CHUNK_SEQ_OFFSET = 1,
+  CHUNK_COUNT_OFFSET = 2,
+};
+
+/** The transfer being reassembled. */
+static struct {
+  uint8_t id;
+  uint8_t chunk_count;  // 0 if no transfer is in progress
+  uint8_t received;     // bitmask of chunks received so far
+  uint16_t length;      // total size, known once the last chunk is in
+  bool has_completed;   // whether completed_id is valid
+  uint8_t completed_id; // the last transfer dispatched
+} current;
+
+/** Reassembly buffer for the current transfer. */
+static uint8_t buffer[TRANSFER_MAX_SIZE];
+
+/** Iterator over a reassembled message. */
+static DictionaryIterator assembled;
+
+/**
+ * @return Bitmask of chunks of the current transfer not yet received.
+ */
+static uint8_t missing_chunks(void) {
+  uint8_t all = (uint8_t) ((1 << current.chunk_count) - 1);
+  return all & ~current.received;
+}
+
+/**
+ * Asks the phone to resend the chunks we're missing.
+ */
+static void send_nack(void) {
+  uint8_t missing = missing_chunks();
+  LOG_WARNING("Transfer %d missing chunks 0x%02x.", current.id, missing);
+  outbox_queue_send_int(XFER_NACK_KEY, (current.id << 16) | missing);
+}
+
+// Docs are in the header file.
+DictionaryIterator *transfer_receive(DictionaryIterator *iter) {
+  Tuple *chunk = dict_find(iter, XFER_CHUNK_KEY);
+  if (!chunk) {
+    if (dict_find(iter, UPDATE_FREQ_KEY)) {
+      // The phone may have restarted and picked its transfer IDs afresh, so
+      // a repeat of the last ID is no longer a resend:
+      current.has_completed = false;
+    }
+    return iter;
+  }
+  if (chunk->type != TUPLE_BYTE_ARRAY || 
+      chunk->length < TRANSFER_HEADER_SIZE) {
+    LOG_ERROR("Ignoring malformed transfer chunk!");
+    return NULL;
+  }
+
+  const uint8_t *data = chunk->value->data;
+  uint8_t id = data[CHUNK_ID_OFFSET];
+  uint8_t seq = data[CHUNK_SEQ_OFFSET];
+  uint8_t chunk_count = data[CHUNK_COUNT_OFFSET];
+  uint16_t data_length = chunk->length - TRANSFER_HEADER_SIZE;
+  bool is_last = seq + 1 == chunk_count;
+  if (chunk_count == 0 || chunk_count > TRANSFER_MAX_CHUNKS || 
+      seq >= chunk_count || data_length > TRANSFER_CHUNK_SIZE || 
+      (!is_last && data_length != TRANSFER_CHUNK_SIZE)) {
+    LOG_ERROR("Ignoring invalid transfer chunk!");
+    return NULL;
+  }
+
+  if (current.has_completed && id == current.completed_id) {
+    return NULL;  // a late resend of a transfer we already dispatched
+  }
+  if (id != current.id || chunk_count != current.chunk_count) {
+    // A new transfer replaces any unfinished one:
+    current.id = id;
+    current.chunk_count = chunk_count;
+    current.received = 0;
+  } else if (current.received & (1 << seq)) {
+    return NULL;  // a resend of a chunk we already have
+  }
+  memcpy(buffer + seq * TRANSFER_CHUNK_SIZE, 
+      data + TRANSFER_HEADER_SIZE, data_length);
+  current.received |= 1 << seq;
+  if (is_last) {
+    current.length = seq * TRANSFER_CHUNK_SIZE + data_length;
+  }
+
+  if (missing_chunks()) {
+    // Chunks are sent in order, so a gap before the last one is a loss:
+    if (is_last) send_nack();
+    return NULL;
+  }
+  current.chunk_count = 0;
+  current.has_completed = true;
+  current.completed_id = id;
+  dict_read_begin_from_buffer(&assembled, buffer, current.length);
+  return &assembled;
+}
+
+// Docs are in the header file.
+void transfer_handle_dropped(AppMessageResult reason, void *context) {
+  if (current.chunk_count > 0) send_nack();
+}
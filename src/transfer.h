@@ -0,0 +1,70 @@
+/**
+ * @section DESCRIPTION
+ *
+ * This module reassembles App Messages that the phone had to split into 
+ * chunks because they're bigger than our inbox. Each chunk is a single 
+ * XFER_CHUNK_KEY byte array:
+ *
+ *   Offset  Size  Field
+ *   0       1     Transfer ID (changes with every new transfer)
+ *   1       1     Chunk sequence number, from 0
+ *   2       1     Number of chunks in the transfer
+ *   3       ...   Chunk data: TRANSFER_CHUNK_SIZE bytes, except the last
+ *
+ * The chunk data put together is a serialized App Message dictionary, which
+ * is dispatched as if it had arrived in one piece. The phone keeps a few 
+ * chunks in flight at once. Chunks may arrive out of order or more than 
+ * once. When a message is dropped, or the last chunk arrives with earlier 
+ * ones missing, we send the phone an XFER_NACK_KEY listing the chunks we 
+ * still need: (transfer ID << 16) | bitmask of missing sequence numbers. The
+ * phone resends only those (see TransferSender in the phone JS).
+ *
+ * Chunks of the transfer we dispatched last are ignored, since they're late
+ * resends. The phone sends its settings (UPDATE_FREQ_KEY) when its JS 
+ * starts, before any transfer, and that clears the last transfer ID: a 
+ * restarted phone picks a new random first ID, which could match it.
+ */
+
+#ifndef __TRANSFER_H__
+#define __TRANSFER_H__
+
+#include <pebble.h>
+
+
+/** Size of the chunk header. */
+#define TRANSFER_HEADER_SIZE 3
+
+/** Size of the data in every chunk but the last. Must match the phone JS. */
+#define TRANSFER_CHUNK_SIZE 80
+
+/** Max number of chunks in a transfer. Must match the phone JS. */
+#define TRANSFER_MAX_CHUNKS 8
+
+/** Size of the largest message that can be transferred. */
+#define TRANSFER_MAX_SIZE (TRANSFER_CHUNK_SIZE * TRANSFER_MAX_CHUNKS)
+
+/**
+ * Passes an incoming App Message through the transfer layer. Call from the 
+ * AppMessageInboxReceived handler before dispatching the message.
+ *
+ * @param iter The received message.
+ * @return The message to dispatch: iter itself if it isn't a chunk, the 
+ *         reassembled message if it was the final missing chunk, or NULL if
+ *         the transfer isn't complete yet. A reassembled message is only 
+ *         valid until the next call.
+ */
+DictionaryIterator *transfer_receive(DictionaryIterator *iter);
+
+/**
+ * A Pebble AppMessageInboxDropped handler. Asks the phone to resend the 
+ * chunks we're missing, if a transfer is in progress. Parent must 
+ * register/dispatch to this handler since each app can only have one.
+ *
+ * @param reason Why the message was dropped (error code).
+ * @param context Application data as specified when registering the callback.
+ *        Unused.
+ */
+void transfer_handle_dropped(AppMessageResult reason, void *context);
+
+
+#endif  // __TRANSFER_H__
@@ -0,0 +1,151 @@
+"""
+Generates App Message key definitions for the watch (C) and phone (JS) from
+the appkeys.json schema, so the key list only has to be maintained in one
+place. Used by the wscript build; can also be run by hand:
+
+    python tools/appkeys.py appkeys.json appinfo.json out_dir
+"""
+
+import json
+import os
+import sys
+
+
+TUPLE_TYPES = {
+    'int32': 'TUPLE_INT',
+    'cstring': 'TUPLE_CSTRING',
+    'bytes': 'TUPLE_BYTE_ARRAY',
+}
+
+
+class SchemaError(Exception):
+    pass
+
+
+def load_schema(path):
+    """Loads and validates the key schema. Returns the list of key entries."""
+    with open(path) as f:
+        keys = json.load(f)['keys']
+    seen_names, seen_keys = set(), set()
+    for entry in keys:
+        name, key = entry['name'], entry['key']
+        if name in seen_names or key in seen_keys:
+            raise SchemaError('Duplicate App Message key: %s (%d)' % (name, key))
+        if entry['type'] not in TUPLE_TYPES:
+            raise SchemaError('Unknown type for %s: %s' % (name, entry['type']))
+        if key < 0 or key > 255:
+            raise SchemaError('Key out of range for %s: %d' % (name, key))
+        seen_names.add(name)
+        seen_keys.add(key)
+    return sorted(keys, key=lambda entry: entry['key'])
+
+
+def check_appinfo(keys, appinfo_path):
+    """Raises SchemaError unless appinfo.json appKeys match the schema."""
+    with open(appinfo_path) as f:
+        app_keys = json.load(f).get('appKeys', {})
+    expected = dict((entry['name'], entry['key']) for entry in keys)
+    if app_keys != expected:
+        raise SchemaError('appinfo.json appKeys are out of sync with the key '
+                          'schema. Expected: %s' % json.dumps(expected))
+
+
+def render_header(keys):
+    count = max(entry['key'] for entry in keys) + 1
+    handlers = [entry['handler'] for entry in keys if entry['handler']]
+    out = [
+        '// Generated from appkeys.json by tools/appkeys.py. Do not edit.',
+        '',
+        '#ifndef __APPKEYS_AUTO_H__',
+        '#define __APPKEYS_AUTO_H__',
+        '',
+        '#include <pebble.h>',
+        '',
+        '',
+        '/** Key mappings for KV pairs passed between the watch and phone. */',
+        'enum AppMessageKey {',
+    ]
+    for entry in keys:
+        out.append('  %s = %d,  // %s - %s' % (
+            entry['name'], entry['key'], entry['type'], entry['doc']))
+    out += [
+        '};',
+        '',
+        '/** One past the highest App Message key. Sizes the dispatch tables. */',
+        '#define APP_KEY_COUNT %d' % count,
+        '',
+        '/**',
+        ' * Handles one inbound tuple. The tuple type has already been checked',
+        ' * against the schema.',
+        ' *',
+        ' * @param tuple The tuple to process.',
+        ' */',
+        'typedef void (*AppKeyHandler)(const Tuple *tuple);',
+        '',
+        '/** Inbound handlers, indexed by key. NULL for keys we never receive. */',
+        'extern const AppKeyHandler app_key_handlers[APP_KEY_COUNT];',
+        '',
+        '/** Expected tuple type, indexed by key. */',
+        'extern const uint8_t app_key_types[APP_KEY_COUNT];',
+        '',
+        '// Handlers named in the schema, defined by their owning modules:',
+    ]
+    out += ['void %s(const Tuple *tuple);' % handler for handler in handlers]
+    out += [
+        '',
+        '',
+        '#endif  // __APPKEYS_AUTO_H__',
+        '',
+    ]
+    return '\n'.join(out)
+
+
+def render_source(keys):
+    out = [
+        '// Generated from appkeys.json by tools/appkeys.py. Do not edit.',
+        '',
+        '#include <pebble.h>',
+        '#include "appkeys.auto.h"',
+        '',
+        '',
+        'const AppKeyHandler app_key_handlers[APP_KEY_COUNT] = {',
+    ]
+    out += ['  [%s] = %s,' % (entry['name'], entry['handler'])
+            for entry in keys if entry['handler']]
+    out += [
+        '};',
+        '',
+        'const uint8_t app_key_types[APP_KEY_COUNT] = {',
+    ]
+    out += ['  [%s] = %s,' % (entry['name'], TUPLE_TYPES[entry['type']])
+            for entry in keys]
+    out += ['};', '']
+    return '\n'.join(out)
+
+
+def render_js(keys):
+    out = [
+        '// Generated from appkeys.json by tools/appkeys.py. Do not edit.',
+        '',
+        '/** App Message key names mapped to their numeric keys. */',
+        'APP_KEYS = {',
+    ]
+    out += ['  %s: %d,' % (entry['name'], entry['key']) for entry in keys]
+    out += ['};', '', '']
+    return '\n'.join(out)
+
+
+def generate(schema_path, appinfo_path, out_dir):
+    """Writes appkeys.auto.{h,c,js} into out_dir."""
+    keys = load_schema(schema_path)
+    check_appinfo(keys, appinfo_path)
+    for ext, render in (('h', render_header), ('c', render_source),
+                        ('js', render_js)):
+        with open(os.path.join(out_dir, 'appkeys.auto.' + ext), 'w') as f:
+            f.write(render(keys))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 4:
+        sys.exit(__doc__)
+    generate(*sys.argv[1:])
@@ -0,0 +1,99 @@
+"""
+Pre-renders the clock's digits and colon into a one-row bitmap atlas, so the
+watch can draw the time by copying a few small bitmaps instead of running the
+53 px custom font through the text renderer every minute. Writes the atlas
+PNG (a watch resource) and a C header with its geometry. Both are checked
+in, since rendering needs Pillow; rerun by hand if the font or size changes:
+
+    python tools/digit_atlas.py resources/fonts/futura_condensed_bold-webfont.ttf \\
+        53 resources/images/clock_digits.png src/digit_atlas.h
+
+Every digit gets a cell as wide as the widest digit, with the glyph centered,
+so the time's layout doesn't shift as the digits change. The colon gets its
+own, narrower cell. Cells are cropped vertically to the ink of the tallest
+glyph; DIGIT_ATLAS_TOP is where that crop starts below the top of a line of
+text, for placing the cells where the text used to be.
+"""
+
+import os
+import sys
+
+from PIL import Image, ImageDraw, ImageFont
+
+
+GLYPHS = '0123456789:'
+
+
+def render(font_path, size):
+    """Renders the atlas. Returns the image and a dict of its geometry."""
+    font = ImageFont.truetype(font_path, size)
+    advances = dict((glyph, int(round(font.getlength(glyph))))
+                    for glyph in GLYPHS)
+    digit_width = max(advances[digit] for digit in GLYPHS[:10])
+    colon_width = advances[':']
+    ascent, descent = font.getmetrics()
+
+    # Draw each glyph centered in its cell, on the text's line box:
+    line = Image.new('L', (digit_width * 10 + colon_width, ascent + descent))
+    draw = ImageDraw.Draw(line)
+    for i, glyph in enumerate(GLYPHS):
+        cell_width = digit_width if glyph != ':' else colon_width
+        x = i * digit_width + (cell_width - advances[glyph]) // 2
+        draw.text((x, 0), glyph, font=font, fill=255)
+
+    # 1 bit, and cropped to the rows with ink:
+    line = line.point(lambda value: 255 if value >= 128 else 0, '1')
+    _, top, _, bottom = line.getbbox()
+    atlas = line.crop((0, top, line.width, bottom))
+    return atlas, {
+        'DIGIT_WIDTH': digit_width,
+        'COLON_WIDTH': colon_width,
+        'HEIGHT': bottom - top,
+        'TOP': top,
+    }
+
+
+def render_header(font_path, size, geometry):
+    font_name = os.path.basename(font_path)
+    out = [
+        '// Generated from %s (%d px) by tools/digit_atlas.py. Do not edit.'
+        % (font_name, size),
+        '',
+        '#ifndef __DIGIT_ATLAS_H__',
+        '#define __DIGIT_ATLAS_H__',
+        '',
+        '',
+        '/** Width of each digit cell. Digits 0-9 are the first ten cells. */',
+        '#define DIGIT_ATLAS_DIGIT_WIDTH %d' % geometry['DIGIT_WIDTH'],
+        '',
+        '/** Width of the colon cell, which follows the digits. */',
+        '#define DIGIT_ATLAS_COLON_WIDTH %d' % geometry['COLON_WIDTH'],
+        '',
+        '/** Height of every cell. */',
+        '#define DIGIT_ATLAS_HEIGHT %d' % geometry['HEIGHT'],
+        '',
+        '/** Rows between the top of a line of text and the top of the cells. */',
+        '#define DIGIT_ATLAS_TOP %d' % geometry['TOP'],
+        '',
+        '',
+        '#endif  // __DIGIT_ATLAS_H__',
+        '',
+    ]
+    return '\n'.join(out)
+
+
+def main(argv):
+    if len(argv) != 5:
+        sys.stderr.write('Usage: %s font.ttf size atlas.png atlas.h\n'
+                         % argv[0])
+        return 2
+    font_path, size, png_path, header_path = argv[1:]
+    atlas, geometry = render(font_path, int(size))
+    atlas.save(png_path, optimize=True)
+    with open(header_path, 'w') as f:
+        f.write(render_header(font_path, int(size), geometry))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
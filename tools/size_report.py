@@ -0,0 +1,71 @@
+"""
+Reports how much of the watch app's memory each module takes, from the sizes
+of the compiled objects and the linked app, and checks the app against a
+memory budget. On the watch the whole app (code, initialized data and
+zeroed data) is loaded into the same RAM as the heap, so everything the
+budget doesn't cover is left for the heap. Used by the wscript build; can
+also be run by hand on a build:
+
+    python tools/size_report.py arm-none-eabi-size budget app.elf module.o...
+
+A budget of 0 only reports.
+"""
+
+import os
+import subprocess
+import sys
+
+
+class BudgetError(Exception):
+    pass
+
+
+def measure(size_program, paths):
+    """Runs size on each path. Returns a list of (name, text, data, bss)."""
+    output = subprocess.check_output([size_program] + list(paths))
+    sizes = []
+    # Berkeley format: a header line, then text data bss dec hex filename.
+    for line in output.decode('ascii', 'replace').splitlines()[1:]:
+        fields = line.split(None, 5)
+        name = os.path.basename(fields[5])
+        sizes.append((name, int(fields[0]), int(fields[1]), int(fields[2])))
+    return sizes
+
+
+def render_report(app, modules, budget):
+    """Returns the report, one line per module, largest first."""
+    row = '%-28s %7s %7s %7s %7s'
+    out = [row % ('module', '.text', '.data', '.bss', 'total')]
+    for name, text, data, bss in sorted(
+            modules, key=lambda module: -sum(module[1:])):
+        out.append(row % (name, text, data, bss, text + data + bss))
+    name, text, data, bss = app
+    others = [text - sum(module[1] for module in modules),
+              data - sum(module[2] for module in modules),
+              bss - sum(module[3] for module in modules)]
+    out.append(row % tuple(['(other)'] + others + [sum(others)]))
+    out.append(row % (name, text, data, bss, text + data + bss))
+    if budget:
+        out.append('Budget: %d bytes, %d left' %
+                   (budget, budget - (text + data + bss)))
+    return '\n'.join(out)
+
+
+def check(size_program, budget, app_path, module_paths):
+    """Prints the report. Raises BudgetError if the app is over budget."""
+    sizes = measure(size_program, [app_path] + list(module_paths))
+    app, modules = sizes[0], sizes[1:]
+    print(render_report(app, modules, budget))
+    total = sum(app[1:])
+    if budget and total > budget:
+        raise BudgetError('%s takes %d bytes, over the %d byte budget.' %
+                          (app[0], total, budget))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) < 4:
+        sys.exit(__doc__)
+    try:
+        check(sys.argv[1], int(sys.argv[2]), sys.argv[3], sys.argv[4:])
+    except BudgetError as e:
+        sys.exit(str(e))